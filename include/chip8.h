@@ -1,21 +1,62 @@
 #ifndef __CHIP_8_H__
 #define __CHIP_8_H__
 
+#include <stddef.h>
 #include <stdint.h>
+#include <stdatomic.h>
 
-#define CHIP8_MEMORY_SIZE    (4096)
+#define CHIP8_MEMORY_SIZE    (65536) /* XO-CHIP, classic ROMs only see 4 KB */
 #define CHIP8_REGISTERS_SIZE (16)
 #define CHIP8_KEYPAD_SIZE    (0xF)
-#define CHIP8_STACK_SIZE     (16 * 2) /* 16 levels stack, each 2 byte */
+#define CHIP8_STACK_SIZE     (16) /* architectural call depth */
+#define CHIP8_STACK_RING     (32) /* power of two, the rest are guard slots */
+#define CHIP8_STACK_MASK     (CHIP8_STACK_RING - 1)
 
-#define CHIP8_DISPLAY_WIDTH  (64)
-#define CHIP8_DISPLAY_HEIGHT (32)
+#define CHIP8_KEYPAD_MASK    (0xFFFF)
+#define CHIP8_KEYPAD_WAITING (0x80000000) /* a thread is parked on keypad */
 
-#define CHIP8_ROM_START    (0x200)
-#define CHIP8_ROM_END      (0xFFF)
-#define CHIP8_MAX_ROM_SIZE (CHIP8_ROM_END - CHIP8_ROM_START)
+/* the display is always stored at SUPER-CHIP resolution, see chip8_display.h */
+#define CHIP8_DISPLAY_WIDTH  (128)
+#define CHIP8_DISPLAY_HEIGHT (64)
+#define CHIP8_DISPLAY_WORDS  (CHIP8_DISPLAY_WIDTH / 64)
+#define CHIP8_LORES_WIDTH    (64)
+#define CHIP8_LORES_HEIGHT   (32)
 
-#define CHIP8_MEM(chip8, index) chip8->memory[index]
+#define CHIP8_TIMER_HZ         (60)
+#define CHIP8_CYCLES_PER_FRAME (11) /* ~660 instructions per second */
+
+#define CHIP8_ROM_START (0x200)
+
+#define CHIP8_FONT_START      (0x050) /* 4x5 hex digits, Fx29 */
+#define CHIP8_FONT_SIZE       (5)
+#define CHIP8_BIG_FONT_START  (0x0A0) /* SUPER-CHIP 8x10 digits, Fx30 */
+#define CHIP8_BIG_FONT_SIZE   (10)
+#define CHIP8_FONT_CHARACTERS (16)
+
+#define CHIP8_MEMORY_MASK_CLASSIC (0x0FFF)
+#define CHIP8_MEMORY_MASK_XOCHIP  (0xFFFF)
+
+#define CHIP8_MAX_ROM_SIZE(chip8) ((chip8)->memory_mask + 1 - CHIP8_ROM_START)
+
+/* every access is masked into the mode's address space, no bounds branch */
+#define CHIP8_MEM(chip8, index) chip8->memory[(index) & chip8->memory_mask]
+
+#define CHIP8_PLANES      (4)  /* XO-CHIP bitplanes */
+#define CHIP8_AUDIO_BYTES (16) /* XO-CHIP 128 bit audio pattern */
+#define CHIP8_AUDIO_PITCH (64) /* 4000 Hz playback rate */
+#define CHIP8_LONG_LOAD   (0xF000)
+
+/* self-modifying code detection, see chip8_code.h */
+#define CHIP8_CODE_LINE_SHIFT (4) /* 16 byte lines */
+#define CHIP8_CODE_LINE_MASK  ((1 << CHIP8_CODE_LINE_SHIFT) - 1)
+#define CHIP8_CODE_LINES      (CHIP8_MEMORY_SIZE >> CHIP8_CODE_LINE_SHIFT)
+#define CHIP8_CODE_MAP_WORDS  (CHIP8_CODE_LINES / 64)
+#define CHIP8_CODE_WATCHERS   (4)
+
+/* pages written since the watchdog last hashed them, see chip8_watchdog.h */
+#define CHIP8_DIRTY_PAGE_SHIFT (8) /* 256 byte pages */
+#define CHIP8_DIRTY_PAGES      (CHIP8_MEMORY_SIZE >> CHIP8_DIRTY_PAGE_SHIFT)
+#define CHIP8_DIRTY_MAP_WORDS  (CHIP8_DIRTY_PAGES / 64)
 
 #define CHIP8_OPCODE_MASK       (0xF000)
 #define CHIP8_LOWER_8_BITS_MASK (0xFF)
@@ -28,7 +69,13 @@
 #define CHIP8_V0(chip8)    CHIP8_Vx(chip8, 0x00)
 #define CHIP8_VF(chip8)    CHIP8_Vx(chip8, 0x0F)
 
-#define CHIP8_STACK_TOP(chip8) chip8->stack[chip8->stack_pointer]
+/**
+ * the stack pointer counts entries, the index is masked into the ring so a
+ * runaway call or return lands in a guard slot instead of past the array.
+ * Calls and returns only set `stack_fault`, chip8_run() reports it.
+ */
+#define CHIP8_STACK_TOP(chip8)                                                 \
+    chip8->stack[(chip8->stack_pointer - 1) & CHIP8_STACK_MASK]
 
 #define CHIP8_ASSERT_PTR(chip8, err)                                           \
     do {                                                                       \
@@ -37,31 +84,59 @@
         }                                                                      \
     } while (0)
 
-#define CHIP8_ASSERT_SP_VALID(chip8, err)                                      \
+#define CHIP8_ASSERT_VALID_REGISTER(chip8, r, err)                             \
     do {                                                                       \
-        if (chip8->stack_pointer < 0 ||                                        \
-            chip8->stack_pointer > CHIP8_STACK_SIZE) {                         \
+        if ((r) >= CHIP8_REGISTERS_SIZE) {                                     \
             return err;                                                        \
         }                                                                      \
     } while (0)
 
-#define CHIP8_ASSERT_VALID_REGISTER(chip8, r, err)                             \
+#define CHIP8_ASSERT_MODE(chip8, m, err)                                       \
     do {                                                                       \
-        if (r < 0 || r > CHIP8_REGISTERS_SIZE) {                               \
+        if ((chip8)->mode != (m)) {                                            \
             return err;                                                        \
         }                                                                      \
     } while (0)
 
 #define CHIP8_ASSERT_VALID_KEY(chip8, k, err)                                  \
     do {                                                                       \
-        if (k < 0 || k >= CHIP8_KEYPAD_SIZE) {                                 \
+        if ((k) > CHIP8_KEYPAD_SIZE) {                                         \
             return err;                                                        \
         }                                                                      \
     } while (0)
 
+#define CHIP8_FNV_OFFSET (0xcbf29ce484222325ull)
+#define CHIP8_FNV_PRIME  (0x100000001b3ull)
+
+/* FNV-1a, for ROM identity and cache checksums; not cryptographic */
+static inline uint64_t chip8_fnv1a(uint64_t hash, const void *data,
+                                   size_t len)
+{
+    const uint8_t *bytes = data;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= CHIP8_FNV_PRIME;
+    }
+
+    return hash;
+}
+
 struct chip8;
 typedef struct chip8 chip8_t;
 
+struct chip8_profile;
+struct chip8_debug;
+struct chip8_trace;
+
+typedef enum
+{
+    CHIP8_MODE_CHIP8 = 0,
+    CHIP8_MODE_SCHIP,
+    CHIP8_MODE_XOCHIP,
+    CHIP8_MODE_MAX, /* must be last one */
+} chip8_mode_t;
+
 typedef enum
 {
     CHIP8_KEY_IDLE,
@@ -81,32 +156,150 @@ typedef enum
     CHIP8_INVALID_STACK_PTR_ERR,
     CHIP8_INVALID_REGISTER_ERR,
     CHIP8_INVALID_KEY_ERR,
+    CHIP8_KEY_WAIT, /* Fx0A is waiting for a key press */
+    CHIP8_BREAK,    /* a breakpoint or watchpoint hit, see chip8_debug.h */
+    CHIP8_STUCK,    /* the state repeats, see chip8_watchdog.h */
+    CHIP8_DIVERGED, /* two engines disagree, see chip8_lockstep.h */
     CHIP8_ERR,
     CHIP8_MAX, /* must be last one */
 } chip8_error_code_t;
 
+typedef uint64_t chip8_row_t[CHIP8_DISPLAY_WORDS];
+
 typedef int (*chip8_cycle_handler)(chip8_t *chip8);
+typedef int (*chip8_run_handler)(chip8_t *chip8, unsigned int cycles,
+                                 unsigned int *executed);
 typedef int (*decode_handler)(chip8_t *chip8, uint16_t command);
 
+/* called with the whole lines around a guest write that hit decoded code */
+typedef void (*chip8_invalidate_handler)(void *ctx, uint16_t address,
+                                         uint32_t len);
+
+typedef struct
+{
+    chip8_invalidate_handler handler;
+    void                    *ctx;
+} chip8_code_watcher_t;
+
 struct chip8
 {
     chip8_cycle_handler cycle_handler;
-    uint8_t             draw;
-    uint16_t            program_counter;
-    uint16_t            stack_pointer;
-    uint16_t            i_register;
+    chip8_mode_t        mode;
+    uint16_t            memory_mask;
+
+    /**
+     * execution engine behind chip8_run(): chip8_interpret() by default,
+     * replaced by engines that cache decoded code (see chip8_decode.h).
+     */
+    chip8_run_handler run_handler;
+    void             *run_ctx;
+
+    /* FNV-1a of the ROM image, keys compiled and cached code for it */
+    uint64_t rom_hash;
+    uint32_t rom_size;
+
+    /**
+     * one bit per key, written by the input thread and read by the cpu
+     * thread. Kept in a 32 bit word so it can double as a futex; only the
+     * low 16 bits hold key state, bit 31 flags a parked Fx0A waiter.
+     */
+    _Atomic uint32_t keypad;
+
+    /**
+     * one bit per CHIP8_CODE_LINE_SHIFT sized line of memory that some
+     * cache holds decoded code for. Guest stores test it and only call the
+     * watchers when they hit a marked line; code_generation counts those
+     * invalidations so caches can cheaply tell whether anything changed,
+     * code_marks counts chip8_code_mark() calls.
+     */
+    uint64_t             code_map[CHIP8_CODE_MAP_WORDS];
+    uint32_t             code_generation;
+    uint32_t             code_marks;
+    chip8_code_watcher_t code_watchers[CHIP8_CODE_WATCHERS];
+
+    /* one bit per CHIP8_DIRTY_PAGE_SHIFT sized page a guest store touched */
+    uint64_t dirty_map[CHIP8_DIRTY_MAP_WORDS];
+
+    /* NULL unless a profiler is attached, see chip8_profile.h */
+    struct chip8_profile *profile;
+
+    /* NULL unless a breakpoint or watchpoint is set, see chip8_debug.h */
+    struct chip8_debug *debug;
+
+    /* NULL unless execution is traced, see chip8_trace.h */
+    struct chip8_trace *trace;
+
+    /* Ex9E, ExA1 and Fx0A executed, so the watchdog can tell input polls */
+    uint32_t key_reads;
+
+    /**
+     * architectural state: everything from `draw` to the end of the struct
+     * is what chip8_save_state() copies, keep host-side fields above.
+     */
+    uint8_t  draw;
+    uint8_t  hires; /* SUPER-CHIP 128x64 mode */
+    uint16_t program_counter;
+    uint16_t stack_pointer; /* entries on the stack */
+    uint8_t  stack_fault;   /* sticky, set on call overflow/return underflow */
+    uint16_t i_register;
 
     uint8_t delay_timer;
     uint8_t sound_timer;
 
-    uint8_t stack[CHIP8_STACK_SIZE];
+    uint8_t  key_waiting;
+    uint16_t key_wait_mask; /* keys already held when Fx0A began */
+    uint32_t rng;           /* Cxkk xorshift state */
+
+    uint8_t planes; /* XO-CHIP bitplanes selected by Fn01 */
+    uint8_t pitch;  /* XO-CHIP Fx3A */
+    uint8_t audio_pattern[CHIP8_AUDIO_BYTES];
+
+    uint16_t stack[CHIP8_STACK_RING]; /* ring, see CHIP8_STACK_TOP */
+    uint8_t  registers[CHIP8_REGISTERS_SIZE];
+    uint8_t  flags[CHIP8_REGISTERS_SIZE]; /* SUPER-CHIP Fx75/Fx85 */
+
+    /**
+     * plane-major: each bitplane is a full packed framebuffer, so drawing
+     * and scrolling a plane touches only that plane's words. Rows are 16
+     * byte aligned so scrolls can use aligned vector loads.
+     */
+    _Alignas(16) chip8_row_t display[CHIP8_PLANES][CHIP8_DISPLAY_HEIGHT];
+
+    /* must stay last: snapshots only copy memory_mask + 1 bytes of it */
     uint8_t memory[CHIP8_MEMORY_SIZE];
-    uint8_t registers[CHIP8_REGISTERS_SIZE];
-    uint8_t keypad_state[CHIP8_KEYPAD_SIZE + 1];
-    uint8_t display[CHIP8_DISPLAY_HEIGHT][CHIP8_DISPLAY_WIDTH];
 };
 
-int  chip8_init(chip8_t *chip8, const char *rom_file);
+#define CHIP8_STATE_OFFSET offsetof(chip8_t, draw)
+#define CHIP8_STATE_SIZE   (sizeof(chip8_t) - CHIP8_STATE_OFFSET)
+#define CHIP8_STATE_USED(chip8)                                                \
+    (offsetof(chip8_t, memory) - CHIP8_STATE_OFFSET + (chip8)->memory_mask + 1)
+
+typedef struct
+{
+    _Alignas(16) uint8_t data[CHIP8_STATE_SIZE];
+    uint32_t code_generation; /* chip8_t.code_generation when saved */
+    uint32_t code_marks;      /* chip8_t.code_marks when saved */
+} chip8_snapshot_t;
+
+int         chip8_mode_parse(const char *name, chip8_mode_t *mode);
+const char *chip8_mode_name(chip8_mode_t mode);
+
+int  chip8_init(chip8_t *chip8, const char *rom_file, chip8_mode_t mode);
+int  chip8_run(chip8_t *chip8, unsigned int cycles, unsigned int *executed);
+int  chip8_interpret(chip8_t *chip8, unsigned int cycles,
+                     unsigned int *executed);
+int  chip8_execute(chip8_t *chip8, uint16_t command);
+void chip8_tick_timers(chip8_t *chip8);
+
+/* in-place save / restore of the architectural state, a single memcpy */
+void chip8_save_state(const chip8_t *chip8, chip8_snapshot_t *snapshot);
+void chip8_load_state(chip8_t *chip8, const chip8_snapshot_t *snapshot);
+
+/* keypad, safe to call from any thread */
+uint16_t chip8_keypad(chip8_t *chip8);
+void     chip8_keypad_set(chip8_t *chip8, uint8_t key, chip8_key_state_t state);
+int      chip8_keypad_wait(chip8_t *chip8, uint16_t keys, long timeout_nsec);
+
 void chip8_cleanup(chip8_t *chip8);
 
 #endif /* __CHIP_8_H__ */
\ No newline at end of file
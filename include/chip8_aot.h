@@ -0,0 +1,75 @@
+#ifndef __CHIP_8_AOT_H__
+#define __CHIP_8_AOT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+/**
+ * Ahead-of-time compiled ROMs. tools/chip8_aot.c walks a ROM's control
+ * flow graph, emits every basic block it reaches as a C function and
+ * builds the result into a shared object named after the ROM hash and
+ * mode. chip8_aot_init() loads the module matching the running ROM and
+ * installs it as the run handler.
+ *
+ * Anything the walk could not see, the targets of Bnnn and code the ROM
+ * rewrites at run time, runs on the interpreter: a block is only entered
+ * while no store reached its bytes, or they still equal the bytes it was
+ * compiled from.
+ */
+
+#define CHIP8_AOT_VERSION   (1) /* bump whenever generated code would change */
+#define CHIP8_AOT_SYMBOL    "chip8_aot_module"
+#define CHIP8_AOT_MAX_BLOCK (32) /* instructions */
+
+typedef int (*chip8_aot_execute)(chip8_t *chip8, uint16_t command);
+
+/**
+ * Runs a block, stopping early once `budget` (at least 1) instructions
+ * ran. Returns with the program counter at the next instruction and the
+ * number of instructions run in `retired`, including one that failed.
+ */
+typedef int (*chip8_aot_block_fn)(chip8_t *chip8, chip8_aot_execute execute,
+                                  unsigned int budget, unsigned int *retired);
+
+typedef struct
+{
+    uint16_t           address;
+    uint16_t           bytes;  /* guest code covered, from address */
+    uint16_t           length; /* instructions in the block */
+    uint32_t           code;   /* offset of the source bytes in `code` */
+    chip8_aot_block_fn run;
+} chip8_aot_block_t;
+
+typedef struct
+{
+    uint32_t                 version;
+    uint32_t                 state_size; /* sizeof(chip8_t) when built */
+    uint64_t                 rom_hash;
+    uint32_t                 mode;
+    uint32_t                 count;
+    const chip8_aot_block_t *blocks;
+    const uint8_t           *code;
+} chip8_aot_module_t;
+
+struct chip8_aot;
+typedef struct chip8_aot chip8_aot_t;
+
+struct chip8_aot
+{
+    chip8_t                  *chip8;
+    void                     *handle;
+    const chip8_aot_module_t *module;
+    const chip8_aot_block_t  *table[CHIP8_MEMORY_SIZE];
+    uint8_t                   stale[CHIP8_MEMORY_SIZE]; /* by block address */
+};
+
+int chip8_aot_path(char *path, size_t len, const char *dir, uint64_t rom_hash,
+                   chip8_mode_t mode);
+
+/* returns CHIP8_ROM_ERR when `dir` holds no usable module for the ROM */
+int  chip8_aot_init(chip8_aot_t *aot, chip8_t *chip8, const char *dir);
+void chip8_aot_cleanup(chip8_aot_t *aot);
+
+#endif /* __CHIP_8_AOT_H__ */
@@ -0,0 +1,57 @@
+#ifndef __CHIP_8_CODE_H__
+#define __CHIP_8_CODE_H__
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+/**
+ * Self-modifying code detection for anything that caches decoded code.
+ *
+ * A cache marks the lines it decoded with chip8_code_mark() and registers a
+ * watcher. Every guest store then runs chip8_code_written(), which for a
+ * store into plain data costs a single bit test; a store into a marked line
+ * clears the marks of the lines it touched, bumps code_generation and calls
+ * every watcher with those whole lines.
+ */
+
+#define CHIP8_CODE_LINE(chip8, address)                                        \
+    (((address) & (chip8)->memory_mask) >> CHIP8_CODE_LINE_SHIFT)
+
+static inline uint64_t chip8_code_test(const chip8_t *chip8, uint32_t line)
+{
+    return chip8->code_map[line >> 6] & (1ull << (line & 63));
+}
+
+void chip8_code_invalidate(chip8_t *chip8, uint16_t address, uint32_t len);
+
+/**
+ * Stores are at most 16 bytes (Fx55, 5xy2), so they span at most two
+ * lines and testing the first and last byte covers the whole range. The
+ * same goes for the (larger) dirty pages.
+ */
+static inline void chip8_code_written(chip8_t *chip8, uint16_t address,
+                                      uint32_t len)
+{
+    uint32_t first = (address & chip8->memory_mask) >> CHIP8_DIRTY_PAGE_SHIFT;
+    uint32_t last  = ((address + len - 1) & chip8->memory_mask) >>
+                    CHIP8_DIRTY_PAGE_SHIFT;
+
+    chip8->dirty_map[first >> 6] |= 1ull << (first & 63);
+    chip8->dirty_map[last >> 6] |= 1ull << (last & 63);
+
+    if (chip8_code_test(chip8, CHIP8_CODE_LINE(chip8, address)) |
+        chip8_code_test(chip8, CHIP8_CODE_LINE(chip8, address + len - 1))) {
+        chip8_code_invalidate(chip8, address, len);
+    }
+}
+
+void chip8_code_mark(chip8_t *chip8, uint16_t address, uint32_t len);
+void chip8_code_reset(chip8_t *chip8);
+
+int  chip8_code_watch(chip8_t *chip8, chip8_invalidate_handler handler,
+                      void *ctx);
+void chip8_code_unwatch(chip8_t *chip8, chip8_invalidate_handler handler,
+                        void *ctx);
+
+#endif /* __CHIP_8_CODE_H__ */
@@ -0,0 +1,87 @@
+#ifndef __CHIP_8_COVER_H__
+#define __CHIP_8_COVER_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+/**
+ * Code coverage.
+ *
+ * The coverage engine replaces the run handler and keeps three bitmaps
+ * over the address space:
+ * - executed: every byte of every instruction that ran;
+ * - taken, not taken: the outcomes seen at each skip's address.
+ *
+ * It works in blocks. A block is a straight run of instructions up to one
+ * that can move the program counter elsewhere (a jump, call, return, skip
+ * or key wait). The bytes of a block are set in one go when it ends, so
+ * the only work per instruction is classifying the opcode.
+ *
+ * Coverage files hold the ROM hash and mode. They are merged by OR-ing the
+ * bitmaps, on save and in chip8-cover, which also prints an annotated
+ * disassembly.
+ */
+
+#define CHIP8_COVER_MAGIC   "C8CV"
+#define CHIP8_COVER_VERSION (1)
+#define CHIP8_COVER_WORDS   (CHIP8_MEMORY_SIZE / 64)
+
+typedef enum
+{
+    CHIP8_COVER_EXECUTED = 0,
+    CHIP8_COVER_TAKEN,
+    CHIP8_COVER_NOT_TAKEN,
+    CHIP8_COVER_MAX, /* must be last one */
+} chip8_cover_map_t;
+
+/* followed by CHIP8_COVER_MAX bitmaps of `words` 64 bit words */
+typedef struct
+{
+    char     magic[4];
+    uint16_t version;
+    uint8_t  mode;
+    uint8_t  reserved;
+    uint32_t words;
+    uint32_t rom_size;
+    uint64_t rom_hash;
+} chip8_cover_file_t;
+
+struct chip8_cover;
+typedef struct chip8_cover chip8_cover_t;
+
+struct chip8_cover
+{
+    chip8_t *chip8;
+
+    /* the engine to restore at cleanup */
+    chip8_run_handler run_handler;
+    void             *run_ctx;
+
+    uint64_t map[CHIP8_COVER_MAX][CHIP8_COVER_WORDS];
+};
+
+/* installs the coverage engine as chip8's run handler */
+int  chip8_cover_init(chip8_cover_t *cover, chip8_t *chip8);
+void chip8_cover_cleanup(chip8_cover_t *cover);
+
+static inline int chip8_cover_test(const chip8_cover_t *cover,
+                                   chip8_cover_map_t map, uint16_t address)
+{
+    return (cover->map[map][address >> 6] >> (address & 63)) & 1;
+}
+
+/**
+ * OR a coverage file into `cover`. CHIP8_ROM_READ_ERR if there is none,
+ * CHIP8_ROM_ERR if it belongs to another ROM or mode.
+ */
+int chip8_cover_load(chip8_cover_t *cover, const char *path);
+
+/* merge with what `path` already holds, then replace it */
+int chip8_cover_save(chip8_cover_t *cover, const char *path);
+
+/* one line per instruction slot of the ROM, marked with what ran */
+int chip8_cover_write_listing(const chip8_cover_t *cover, FILE *out);
+
+#endif /* __CHIP_8_COVER_H__ */
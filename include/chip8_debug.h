@@ -0,0 +1,118 @@
+#ifndef __CHIP_8_DEBUG_H__
+#define __CHIP_8_DEBUG_H__
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+/**
+ * Breakpoints and watchpoints.
+ *
+ * Each kind has a bitmap with one bit per address. Breakpoints are tested
+ * before an instruction runs, watchpoints after a guest store. Conditions
+ * are looked up only when a bit is set. A stop makes chip8_run() return
+ * CHIP8_BREAK, and `stop` says why.
+ *
+ * Nothing is checked while no point is set. The debugger's run handler is
+ * installed when the first point is added and the previous engine comes
+ * back when the last one is removed. chip8_t::debug is NULL otherwise, so
+ * store sites pay only that pointer test.
+ */
+
+#define CHIP8_DEBUG_POINTS (32)
+#define CHIP8_DEBUG_WORDS  (CHIP8_MEMORY_SIZE / 64)
+#define CHIP8_DEBUG_ANY    (0xFF) /* no register condition */
+
+typedef enum
+{
+    CHIP8_DEBUG_BREAK = 0,
+    CHIP8_DEBUG_WATCH,
+    CHIP8_DEBUG_MAX, /* must be last one */
+} chip8_debug_kind_t;
+
+typedef enum
+{
+    CHIP8_STOP_NONE = 0,
+    CHIP8_STOP_BREAKPOINT,
+    CHIP8_STOP_WATCHPOINT,
+    CHIP8_STOP_MAX, /* must be last one */
+} chip8_stop_reason_t;
+
+/* a point only stops once Vreg == value (unless reg is ANY) hits `count` */
+typedef struct
+{
+    uint8_t  reg;
+    uint8_t  value;
+    uint32_t count;
+} chip8_debug_cond_t;
+
+typedef struct
+{
+    uint8_t            used;
+    uint8_t            kind;
+    uint16_t           address;
+    uint16_t           len; /* watched bytes */
+    uint32_t           hits;
+    chip8_debug_cond_t cond;
+} chip8_debug_point_t;
+
+typedef struct
+{
+    chip8_stop_reason_t reason;
+    uint16_t            address; /* instruction or stored byte */
+    uint16_t            pc;      /* where execution stopped */
+} chip8_debug_stop_t;
+
+struct chip8_debug;
+typedef struct chip8_debug chip8_debug_t;
+
+struct chip8_debug
+{
+    chip8_t *chip8;
+
+    /* the engine to restore once no point is left */
+    chip8_run_handler run_handler;
+    void             *run_ctx;
+
+    uint64_t            map[CHIP8_DEBUG_MAX][CHIP8_DEBUG_WORDS];
+    chip8_debug_point_t points[CHIP8_DEBUG_POINTS];
+    unsigned int        count;
+
+    chip8_debug_stop_t stop;
+    int32_t            resume; /* breakpoint to step over, -1 for none */
+};
+
+int  chip8_debug_init(chip8_debug_t *debug, chip8_t *chip8);
+void chip8_debug_cleanup(chip8_debug_t *debug);
+
+/**
+ * Add a point. `cond` may be NULL to always stop. Returns CHIP8_ALLOC_ERR
+ * when every slot is in use.
+ */
+int chip8_debug_add(chip8_debug_t *debug, chip8_debug_kind_t kind,
+                    uint16_t address, uint16_t len,
+                    const chip8_debug_cond_t *cond);
+
+/* remove every point of `kind` at `address`, CHIP8_ERR if there was none */
+int chip8_debug_remove(chip8_debug_t *debug, chip8_debug_kind_t kind,
+                       uint16_t address);
+
+static inline uint64_t chip8_debug_test(const chip8_debug_t *debug,
+                                        chip8_debug_kind_t kind,
+                                        uint16_t address)
+{
+    return debug->map[kind][address >> 6] & (1ull << (address & 63));
+}
+
+void chip8_debug_written(chip8_debug_t *debug, uint16_t address,
+                         uint32_t len);
+
+/* for the store sites, next to chip8_code_written() */
+#define CHIP8_DEBUG_WRITTEN(chip8, address, len)                               \
+    do {                                                                       \
+        if (chip8->debug) {                                                    \
+            chip8_debug_written(chip8->debug, address, len);                   \
+        }                                                                      \
+    } while (0)
+
+#endif /* __CHIP_8_DEBUG_H__ */
@@ -0,0 +1,64 @@
+#ifndef __CHIP_8_DECODE_H__
+#define __CHIP_8_DECODE_H__
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define CHIP8_FUSE_MAX_LENGTH (3) /* instructions in the longest pattern */
+
+/**
+ * Decode cache engine. Every address gets its own entry, decoded on first
+ * execution; an entry either holds a single instruction or, when the
+ * instructions starting there match an enabled pattern, the whole group,
+ * which then runs in one dispatch.
+ *
+ * Because entries are per address, a jump or skip into the middle of a
+ * group lands on that address's own entry and runs from there, exactly
+ * like the interpreter would. Entries hold only opcodes, no pointers, and
+ * are dropped through the chip8_code.h watchers when the guest rewrites
+ * them.
+ */
+
+typedef enum
+{
+    CHIP8_FUSE_NONE = 0,
+    CHIP8_FUSE_LOAD_DRAW,  /* Annn, Dxyn */
+    CHIP8_FUSE_LOAD_LOAD,  /* 6xkk, 6ykk */
+    CHIP8_FUSE_COUNT_LOOP, /* 7x01, 3xkk, 1nnn */
+    CHIP8_FUSE_MAX,        /* must be last one */
+} chip8_fuse_t;
+
+#define CHIP8_FUSE_ALL (((1u << CHIP8_FUSE_MAX) - 1) & ~1u)
+
+typedef struct
+{
+    uint16_t command[CHIP8_FUSE_MAX_LENGTH];
+    uint8_t  fuse; /* chip8_fuse_t */
+    uint8_t  valid;
+} chip8_decoded_t;
+
+struct chip8_decoder;
+typedef struct chip8_decoder chip8_decoder_t;
+
+struct chip8_decoder
+{
+    chip8_t        *chip8;
+    uint32_t        fuse_mask; /* 1 << chip8_fuse_t of enabled patterns */
+    chip8_decoded_t entries[CHIP8_MEMORY_SIZE];
+};
+
+/**
+ * `patterns` is a comma separated list of pattern names, as printed by
+ * chip8_fuse_name(), "all" or "none"; NULL enables all of them. Profiling
+ * a ROM tells which ones pay off, so the set is picked at run time.
+ */
+int  chip8_fuse_parse(const char *patterns, uint32_t *mask);
+const char *chip8_fuse_name(chip8_fuse_t fuse);
+
+/* installs the decoder as chip8's run handler */
+int  chip8_decoder_init(chip8_decoder_t *decoder, chip8_t *chip8,
+                        uint32_t fuse_mask);
+void chip8_decoder_cleanup(chip8_decoder_t *decoder);
+
+#endif /* __CHIP_8_DECODE_H__ */
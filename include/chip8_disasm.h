@@ -0,0 +1,18 @@
+#ifndef __CHIP_8_DISASM_H__
+#define __CHIP_8_DISASM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define CHIP8_DISASM_SIZE (24) /* longest mnemonic with operands, plus NUL */
+
+/**
+ * Write the Cowgod style mnemonic of `command` to `buf`, "DW 0x...." when
+ * no instruction set knows it. F000's 16 bit operand is the following
+ * word, which callers that have it print themselves.
+ */
+const char *chip8_disasm(uint16_t command, char *buf, size_t size);
+
+#endif /* __CHIP_8_DISASM_H__ */
@@ -0,0 +1,44 @@
+#ifndef __CHIP_8_DISPLAY_H__
+#define __CHIP_8_DISPLAY_H__
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+/**
+ * Packed 128x64 framebuffer, one bit per pixel and two uint64_t per row.
+ * Bit 63 of word 0 is the leftmost pixel, so a whole row reads as a single
+ * big-endian 128-bit value and horizontal scrolls are plain 128-bit shifts.
+ *
+ * Lo-res (64x32) is stored at double resolution: every logical pixel is a
+ * 2x2 block. Scroll amounts are in pixels of the current mode.
+ *
+ * XO-CHIP bitplanes are independent framebuffers of this layout; every
+ * function here works on the rows of a single plane.
+ */
+
+static inline uint8_t chip8_display_pixel(const chip8_row_t *rows,
+                                          unsigned int x, unsigned int y)
+{
+    return (rows[y][x >> 6] >> (63 - (x & 63))) & 1;
+}
+
+void chip8_display_clear(chip8_row_t *rows);
+
+/**
+ * XOR a sprite onto the display at (x, y) given in current-mode pixels,
+ * wrapping around both edges. `sprite` holds `height` rows of 1 byte each,
+ * or 2 bytes each when `wide` (16x16 Dxy0 sprites). Returns 1 on collision.
+ */
+uint8_t chip8_display_draw(chip8_row_t *rows, const uint8_t *sprite,
+                           unsigned int height, uint8_t wide, unsigned int x,
+                           unsigned int y, uint8_t hires);
+
+void chip8_display_scroll_down(chip8_row_t *rows, unsigned int n,
+                               uint8_t hires);
+void chip8_display_scroll_up(chip8_row_t *rows, unsigned int n,
+                             uint8_t hires);
+void chip8_display_scroll_left(chip8_row_t *rows, uint8_t hires);
+void chip8_display_scroll_right(chip8_row_t *rows, uint8_t hires);
+
+#endif /* __CHIP_8_DISPLAY_H__ */
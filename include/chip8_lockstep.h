@@ -0,0 +1,85 @@
+#ifndef __CHIP_8_LOCKSTEP_H__
+#define __CHIP_8_LOCKSTEP_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+/**
+ * Differential execution of two engines.
+ *
+ * Two machines loaded with the same ROM run side by side. The reference
+ * keeps the default engine, chip8_interpret() on the handlers[] path. The
+ * candidate goes through whatever engine is installed as its run handler.
+ * The candidate runs up to `step` instructions. The reference then runs
+ * exactly as many as the candidate reported, so fused sequences and
+ * compiled blocks are compared as the unit they run as.
+ *
+ * After every batch both machines must agree on the error, on the
+ * architectural state (registers, timers, stack, framebuffer, ...) and
+ * on every memory page either of them wrote since the last batch (see
+ * chip8_t.dirty_map).
+ *
+ * On the first mismatch the batch is replayed from the last state both
+ * agreed on, with the smallest budget that still diverges. The
+ * reference's instructions of that batch are kept for the report.
+ */
+
+#define CHIP8_LOCKSTEP_STEP     (16)
+#define CHIP8_LOCKSTEP_MAX_STEP (256)
+
+typedef struct
+{
+    uint16_t address;
+    uint16_t command;
+} chip8_lockstep_op_t;
+
+struct chip8_lockstep;
+typedef struct chip8_lockstep chip8_lockstep_t;
+
+struct chip8_lockstep
+{
+    chip8_t     *reference;
+    chip8_t     *candidate;
+    unsigned int step;
+
+    uint64_t instructions; /* agreed on */
+    uint64_t batches;
+
+    /* both machines as of the last batch they agreed on */
+    chip8_snapshot_t agreed;
+
+    /* the smallest diverging batch, once CHIP8_DIVERGED was returned */
+    int                 reference_err;
+    int                 candidate_err;
+    unsigned int        candidate_executed;
+    unsigned int        ops_count;
+    chip8_lockstep_op_t ops[CHIP8_LOCKSTEP_MAX_STEP];
+};
+
+/**
+ * Both machines must have loaded the same ROM in the same mode
+ * (CHIP8_ROM_ERR otherwise), and the reference must still run on
+ * chip8_interpret() (CHIP8_ERR otherwise). The candidate is given the
+ * reference's state to start from, random seed included.
+ */
+int chip8_lockstep_init(chip8_lockstep_t *lockstep, chip8_t *reference,
+                        chip8_t *candidate, unsigned int step);
+
+/**
+ * Like chip8_run() on both machines. Errors both agree on are returned as
+ * they are; CHIP8_DIVERGED when they disagree.
+ */
+int chip8_lockstep_run(chip8_lockstep_t *lockstep, unsigned int cycles,
+                       unsigned int *executed);
+
+/* same keys on both */
+void chip8_lockstep_keypad_set(chip8_lockstep_t *lockstep, uint8_t key,
+                               chip8_key_state_t state);
+void chip8_lockstep_tick_timers(chip8_lockstep_t *lockstep);
+
+/* after CHIP8_DIVERGED: the diverging batch and every field that differs */
+int chip8_lockstep_write_report(const chip8_lockstep_t *lockstep, FILE *out);
+
+#endif /* __CHIP_8_LOCKSTEP_H__ */
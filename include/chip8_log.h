@@ -0,0 +1,59 @@
+#ifndef __CHIP_8_LOG_H__
+#define __CHIP_8_LOG_H__
+
+/**
+ * Leveled logging.
+ *
+ * CHIP8_LOG_LEVEL picks the lowest level compiled in (CMake option of the
+ * same name, INFO by default). Below it the macros are an `if (0)`, which
+ * keeps the format checked but generates no code.
+ *
+ * While chip8_log_init() is in effect, a line is formatted into a buffer
+ * owned by the calling thread and published with one release store. No
+ * lock is taken and no syscall is made. A logger thread writes the
+ * buffers out every CHIP8_LOG_PERIOD_MS. When a buffer is full, its lines
+ * are dropped and counted instead of blocking the thread. Before init and
+ * after cleanup, lines go straight to stderr.
+ *
+ * Every line reads "<ms> <level> <thread>: <message>".
+ */
+
+#define CHIP8_LOG_LEVEL_TRACE (0)
+#define CHIP8_LOG_LEVEL_DEBUG (1)
+#define CHIP8_LOG_LEVEL_INFO  (2)
+#define CHIP8_LOG_LEVEL_WARN  (3)
+#define CHIP8_LOG_LEVEL_ERROR (4)
+#define CHIP8_LOG_LEVEL_OFF   (5)
+
+#ifndef CHIP8_LOG_LEVEL
+#define CHIP8_LOG_LEVEL CHIP8_LOG_LEVEL_INFO
+#endif
+
+#define CHIP8_LOG_BUFFER    (1 << 16) /* bytes per thread, a power of two */
+#define CHIP8_LOG_LINE      (256)
+#define CHIP8_LOG_PERIOD_MS (50)
+
+#define CHIP8_LOG_AT(level, ...)                                               \
+    do {                                                                       \
+        if (CHIP8_LOG_LEVEL <= (level)) {                                      \
+            chip8_log((level), __VA_ARGS__);                                   \
+        }                                                                      \
+    } while (0)
+
+#define CHIP8_LOG_TRACE(...) CHIP8_LOG_AT(CHIP8_LOG_LEVEL_TRACE, __VA_ARGS__)
+#define CHIP8_LOG_DEBUG(...) CHIP8_LOG_AT(CHIP8_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define CHIP8_LOG_INFO(...)  CHIP8_LOG_AT(CHIP8_LOG_LEVEL_INFO, __VA_ARGS__)
+#define CHIP8_LOG_WARN(...)  CHIP8_LOG_AT(CHIP8_LOG_LEVEL_WARN, __VA_ARGS__)
+#define CHIP8_LOG_ERROR(...) CHIP8_LOG_AT(CHIP8_LOG_LEVEL_ERROR, __VA_ARGS__)
+
+void chip8_log(int level, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* name shown for the calling thread, at most 15 characters are kept */
+void chip8_log_thread(const char *name);
+
+/* start the logger thread writing to `fd`, 0 on success */
+int  chip8_log_init(int fd);
+void chip8_log_cleanup(void);
+
+#endif /* __CHIP_8_LOG_H__ */
@@ -0,0 +1,68 @@
+#ifndef __CHIP_8_PERF_H__
+#define __CHIP_8_PERF_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+/**
+ * Hardware counters around emulation batches.
+ *
+ * chip8_perf_init() wraps whatever engine is in run_handler at that point:
+ * the interpreter, the decoder or an AOT module. The first batch opens a
+ * perf_event group on the thread that runs it. The counters count user
+ * space only. They are switched on for each chip8_run() batch and off
+ * again after it, so everything between batches stays out: timers, frame
+ * hand-off, waiting. That costs two ioctls per batch and nothing per
+ * instruction.
+ *
+ * Events the host does not have are left out of the report. If the PMU is
+ * oversubscribed, counts are scaled by the time they actually ran.
+ */
+
+typedef enum
+{
+    CHIP8_PERF_CYCLES = 0, /* group leader */
+    CHIP8_PERF_INSTRUCTIONS,
+    CHIP8_PERF_BRANCHES,
+    CHIP8_PERF_BRANCH_MISSES,
+    CHIP8_PERF_L1I_MISSES,
+    CHIP8_PERF_L1D_MISSES,
+    CHIP8_PERF_MAX, /* must be last one */
+} chip8_perf_event_t;
+
+struct chip8_perf;
+typedef struct chip8_perf chip8_perf_t;
+
+struct chip8_perf
+{
+    chip8_t    *chip8;
+    const char *engine; /* name for the report */
+
+    /* the measured engine */
+    chip8_run_handler run_handler;
+    void             *run_ctx;
+
+    int      fds[CHIP8_PERF_MAX];   /* -1 when the host lacks the event */
+    int      slots[CHIP8_PERF_MAX]; /* position in a group read */
+    unsigned opened;  /* events in the group */
+    uint8_t  started; /* the first batch tried to open the group */
+
+    uint64_t executed; /* emulated instructions */
+    uint64_t batches;
+};
+
+/**
+ * Returns CHIP8_ERR with errno set when not even cycles can be counted,
+ * e.g. under a restrictive perf_event_paranoid.
+ */
+int  chip8_perf_init(chip8_perf_t *perf, chip8_t *chip8, const char *engine);
+void chip8_perf_cleanup(chip8_perf_t *perf);
+
+/* scaled totals, 0 for events the host lacks. CHIP8_ERR if none counted */
+int chip8_perf_read(const chip8_perf_t *perf, uint64_t counts[CHIP8_PERF_MAX]);
+
+int chip8_perf_write_report(const chip8_perf_t *perf, FILE *out);
+
+#endif /* __CHIP_8_PERF_H__ */
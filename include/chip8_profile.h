@@ -0,0 +1,123 @@
+#ifndef __CHIP_8_PROFILE_H__
+#define __CHIP_8_PROFILE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+/**
+ * Subroutine call-graph profiler.
+ *
+ * 2nnn and 00EE drive a shadow call stack: every distinct call path is a
+ * node of a call tree, and each retired instruction bumps the `self` count
+ * of the node currently running. Per subroutine inclusive and exclusive
+ * counts are derived from the tree when it is written out, so the per
+ * instruction cost is a single increment.
+ *
+ * The hooks only exist in builds with CHIP8_PROFILE defined; otherwise
+ * they expand to nothing and an attached profiler simply stays empty.
+ * Instructions are counted in the interpreter's fetch path, so engines
+ * that run decoded or compiled code must not be used while profiling.
+ */
+
+#define CHIP8_PROFILE_NODES (4096)
+#define CHIP8_PROFILE_ROOT  (0)
+
+typedef struct
+{
+    uint16_t address; /* subroutine entry, CHIP8_ROM_START for the root */
+    uint16_t parent;
+    uint16_t child;   /* first callee */
+    uint16_t sibling; /* next callee of the same parent */
+    uint32_t calls;
+    uint64_t self; /* instructions retired in exactly this call path */
+} chip8_profile_node_t;
+
+struct chip8_profile;
+typedef struct chip8_profile chip8_profile_t;
+
+struct chip8_profile
+{
+    chip8_t *chip8;
+    uint16_t current; /* node of the running call path */
+    uint16_t count;   /* nodes in use */
+    uint32_t lost;    /* calls not recorded, the node pool was full */
+
+    /**
+     * node per stack level, indexed like chip8_t::stack so the shadow
+     * stack can never drift from the real one on a bad return.
+     */
+    uint16_t             frames[CHIP8_STACK_RING];
+    chip8_profile_node_t nodes[CHIP8_PROFILE_NODES];
+};
+
+int  chip8_profile_init(chip8_profile_t *profile, chip8_t *chip8);
+void chip8_profile_cleanup(chip8_profile_t *profile);
+
+uint16_t chip8_profile_child(chip8_profile_t *profile, uint16_t parent,
+                             uint16_t address);
+
+/* called by 2nnn once the stack pointer holds the callee's level */
+static inline void chip8_profile_call(chip8_profile_t *profile,
+                                      uint16_t level, uint16_t address)
+{
+    uint16_t parent = profile->frames[(level - 1) & CHIP8_STACK_MASK];
+    uint16_t node   = chip8_profile_child(profile, parent, address);
+
+    profile->frames[level & CHIP8_STACK_MASK] = node;
+    profile->current                          = node;
+    profile->nodes[node].calls++;
+}
+
+/* called by 00EE once the stack pointer is back at the caller's level */
+static inline void chip8_profile_return(chip8_profile_t *profile,
+                                        uint16_t level)
+{
+    profile->current = profile->frames[level & CHIP8_STACK_MASK];
+}
+
+static inline void chip8_profile_retire(chip8_profile_t *profile)
+{
+    profile->nodes[profile->current].self++;
+}
+
+#if defined(CHIP8_PROFILE)
+#define CHIP8_PROFILE_CALL(chip8, address)                                     \
+    do {                                                                       \
+        if (chip8->profile) {                                                  \
+            chip8_profile_call(chip8->profile, chip8->stack_pointer, address); \
+        }                                                                      \
+    } while (0)
+#define CHIP8_PROFILE_RETURN(chip8)                                            \
+    do {                                                                       \
+        if (chip8->profile) {                                                  \
+            chip8_profile_return(chip8->profile, chip8->stack_pointer);        \
+        }                                                                      \
+    } while (0)
+#define CHIP8_PROFILE_RETIRE(chip8)                                            \
+    do {                                                                       \
+        if (chip8->profile) {                                                  \
+            chip8_profile_retire(chip8->profile);                              \
+        }                                                                      \
+    } while (0)
+#else
+#define CHIP8_PROFILE_CALL(chip8, address) ((void)0)
+#define CHIP8_PROFILE_RETURN(chip8)        ((void)0)
+#define CHIP8_PROFILE_RETIRE(chip8)        ((void)0)
+#endif
+
+/**
+ * Collapsed stacks, one line per call path with instructions retired in
+ * it: "rom;sub_0246;sub_02A0 1234". flamegraph.pl and speedscope read it.
+ */
+int chip8_profile_write_collapsed(const chip8_profile_t *profile, FILE *out);
+
+/**
+ * Calls, inclusive and exclusive instruction counts per subroutine,
+ * hottest inclusive first. Recursive calls are only counted once towards
+ * the inclusive total.
+ */
+int chip8_profile_write_report(const chip8_profile_t *profile, FILE *out);
+
+#endif /* __CHIP_8_PROFILE_H__ */
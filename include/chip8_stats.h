@@ -0,0 +1,111 @@
+#ifndef __CHIP_8_STATS_H__
+#define __CHIP_8_STATS_H__
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "chip8.h"
+
+/**
+ * Live metrics in shared memory.
+ *
+ * Each emulator maps a small block at CHIP8_STATS_DIR/chip8-<pid>, and
+ * only the io thread writes to it. The block is guarded by a seqlock:
+ * - The writer makes `sequence` odd, copies the sample in, then makes it
+ *   even again. It never waits.
+ * - A reader copies the sample out and keeps the copy only if `sequence`
+ *   was the same even value before and after.
+ * No socket or lock is involved, and a reader cannot slow the emulator
+ * down. chip8-top shows every block it finds.
+ *
+ * The header fields before `sequence` are written once, before `magic`
+ * is set.
+ */
+
+#define CHIP8_STATS_DIR     "/dev/shm"
+#define CHIP8_STATS_PREFIX  "chip8-"
+#define CHIP8_STATS_MAGIC   "C8ST"
+#define CHIP8_STATS_VERSION (1)
+#define CHIP8_STATS_WINDOW  (64) /* frame times behind the percentiles */
+#define CHIP8_STATS_PERIOD  (15) /* timer ticks between publishes */
+
+typedef struct
+{
+    uint64_t instructions; /* executed in real frames, run-ahead excluded */
+    uint64_t frames;       /* presented so far */
+    uint64_t updated_ns;   /* CLOCK_MONOTONIC time of this sample */
+    double   mips;         /* since the previous sample */
+    uint32_t frame_p50_us; /* between presents, over the last window */
+    uint32_t frame_p95_us;
+    uint32_t frame_p99_us;
+    uint32_t frame_max_us;
+    int32_t  drift_us; /* how far timer ticks lag the wall clock */
+    uint16_t pc;
+    uint8_t  turbo;
+    uint8_t  reserved;
+} chip8_stats_sample_t;
+
+typedef struct
+{
+    char     magic[4];
+    uint16_t version;
+    uint16_t size; /* of this block */
+    int32_t  pid;
+    uint8_t  mode;
+    uint8_t  reserved[3];
+    uint64_t rom_hash;
+    char     rom[64]; /* base name, truncated */
+
+    _Atomic uint32_t     sequence;
+    chip8_stats_sample_t sample;
+} chip8_stats_block_t;
+
+struct chip8_stats;
+typedef struct chip8_stats chip8_stats_t;
+
+struct chip8_stats
+{
+    chip8_stats_block_t *block;
+    char                 path[64];
+
+    /* writer side, io thread only */
+    uint64_t start_ns;
+    uint64_t ticks;
+    uint64_t frames;
+    uint64_t present_ns;
+    uint32_t frame_us[CHIP8_STATS_WINDOW];
+    uint32_t frame_count;
+    uint64_t instructions;
+    uint64_t publish_ns;
+    uint64_t publish_ticks;
+};
+
+/* create and map the block for this process */
+int  chip8_stats_init(chip8_stats_t *stats, const chip8_t *chip8,
+                      const char *rom_file);
+void chip8_stats_cleanup(chip8_stats_t *stats);
+
+/**
+ * writer: `ticks` frame timer expirations were just read. Returns non-zero
+ * once CHIP8_STATS_PERIOD ticks have passed since the last publish.
+ */
+int chip8_stats_tick(chip8_stats_t *stats, uint64_t ticks, uint64_t now_ns);
+
+/* writer: a frame went to the screen */
+void chip8_stats_present(chip8_stats_t *stats, uint64_t now_ns);
+
+/* writer: compute a sample and publish it under the seqlock */
+void chip8_stats_publish(chip8_stats_t *stats, uint64_t instructions,
+                         uint16_t pc, uint8_t turbo, uint64_t now_ns);
+
+/**
+ * Reader: copy a consistent sample out of a mapped block. Returns
+ * CHIP8_ERR if the writer was always mid-update, e.g. because it died
+ * there.
+ */
+int chip8_stats_read(const chip8_stats_block_t *block,
+                     chip8_stats_sample_t *sample);
+
+uint64_t chip8_stats_now(void);
+
+#endif /* __CHIP_8_STATS_H__ */
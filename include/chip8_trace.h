@@ -0,0 +1,139 @@
+#ifndef __CHIP_8_TRACE_H__
+#define __CHIP_8_TRACE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "chip8.h"
+
+/**
+ * Execution trace.
+ *
+ * The interpreter appends one fixed-size record per instruction to a
+ * single-producer ring. The cpu thread never waits: it writes the slot and
+ * publishes `head`. A writer thread drains the ring every
+ * CHIP8_TRACE_PERIOD_MS, delta-encodes a chunk of records against the one
+ * before it, packs the result with a small LZ4-style compressor and
+ * appends it to the trace file. If the writer falls more than a ring
+ * behind, the overwritten records are counted in `dropped` and skipped.
+ *
+ * When an instruction returns an error, the whole ring is also written
+ * synchronously to "<path>.dump", so the run-up to a failure survives
+ * even when the stream lagged.
+ *
+ * File layout: a chip8_trace_file_t header, then frames. Each frame is a
+ * chip8_trace_frame_t followed by `packed` bytes, which unpack to `count`
+ * records. Delta coding restarts at every frame. chip8-trace prints the
+ * records.
+ */
+
+#define CHIP8_TRACE_MAGIC     "C8TR"
+#define CHIP8_TRACE_VERSION   (1)
+#define CHIP8_TRACE_RING      (1 << 16) /* records, a power of two */
+#define CHIP8_TRACE_CHUNK     (4096)    /* records per frame */
+#define CHIP8_TRACE_PERIOD_MS (10)
+
+typedef struct
+{
+    uint32_t cycle; /* instructions traced before this one, low 32 bits */
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t i_register; /* after execution */
+    uint8_t  x;          /* the register in the opcode's x position */
+    uint8_t  vx;         /* and its value after execution */
+} chip8_trace_record_t;
+
+typedef struct
+{
+    char     magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint8_t  mode;
+    uint8_t  reserved[7];
+    uint64_t rom_hash;
+} chip8_trace_file_t;
+
+typedef struct
+{
+    uint32_t count;  /* records */
+    uint32_t packed; /* bytes that follow */
+} chip8_trace_frame_t;
+
+struct chip8_trace;
+typedef struct chip8_trace chip8_trace_t;
+
+struct chip8_trace
+{
+    chip8_t *chip8;
+
+    /* cpu thread */
+    chip8_trace_record_t *ring;
+    _Atomic uint64_t      head;
+    uint32_t              cycle;
+    uint8_t               dumped;
+
+    /* writer thread */
+    uint64_t    tail;
+    uint64_t    dropped;
+    FILE       *out;
+    char       *path;
+    pthread_t   thread;
+    atomic_bool stop;
+    uint8_t     started;
+};
+
+int  chip8_trace_init(chip8_trace_t *trace, chip8_t *chip8, const char *path);
+void chip8_trace_cleanup(chip8_trace_t *trace);
+
+/* called by the interpreter once the instruction at `pc` has run */
+static inline void chip8_trace_record(chip8_trace_t *trace,
+                                      const chip8_t *chip8, uint16_t pc,
+                                      uint16_t command)
+{
+    uint64_t              head   = atomic_load_explicit(&trace->head,
+                                                        memory_order_relaxed);
+    chip8_trace_record_t *record = &trace->ring[head & (CHIP8_TRACE_RING - 1)];
+    uint8_t               x      = CHIP8_NIBBLE(command, 3);
+
+    record->cycle      = trace->cycle++;
+    record->pc         = pc;
+    record->opcode     = command;
+    record->i_register = chip8->i_register;
+    record->x          = x;
+    record->vx         = chip8->registers[x];
+
+    atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
+
+/* write the ring to "<path>.dump", once per trace */
+void chip8_trace_dump(chip8_trace_t *trace);
+
+#define CHIP8_TRACE(chip8, pc, command, err)                                   \
+    do {                                                                       \
+        if (chip8->trace) {                                                    \
+            chip8_trace_record(chip8->trace, chip8, pc, command);              \
+            if (err != CHIP8_OK && err != CHIP8_KEY_WAIT) {                    \
+                chip8_trace_dump(chip8->trace);                                \
+            }                                                                  \
+        }                                                                      \
+    } while (0)
+
+/**
+ * LZ4-style block codec used for the frames. chip8_trace_pack() needs
+ * CHIP8_TRACE_PACK_BOUND(len) bytes of output. chip8_trace_unpack()
+ * returns the unpacked size, or -1 on corrupt input or a short `dst`.
+ */
+#define CHIP8_TRACE_PACK_BOUND(len) ((len) + (len) / 255 + 16)
+
+size_t chip8_trace_pack(const uint8_t *src, size_t len, uint8_t *dst);
+long   chip8_trace_unpack(const uint8_t *src, size_t len, uint8_t *dst,
+                          size_t size);
+
+/* bytewise delta against the previous record, in place */
+void chip8_trace_delta(uint8_t *records, size_t count);
+void chip8_trace_undelta(uint8_t *records, size_t count);
+
+#endif /* __CHIP_8_TRACE_H__ */
@@ -0,0 +1,49 @@
+#ifndef __CHIP_8_WATCHDOG_H__
+#define __CHIP_8_WATCHDOG_H__
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+/**
+ * Hung ROM detection.
+ *
+ * The caller runs chip8_watchdog_check() at frame boundaries, every so
+ * many frames. Each check hashes the whole architectural state:
+ * registers, I, PC, stack, timers, RNG and the packed framebuffer.
+ * Memory is hashed per page, and only the pages guest stores dirtied
+ * since the last check are rehashed (see chip8_code_written()).
+ *
+ * The machine is deterministic apart from the keypad. So if a state comes
+ * back while the keys have not changed, the ROM will loop through the
+ * same states forever. The check then returns CHIP8_STUCK. The last
+ * CHIP8_WATCHDOG_HISTORY hashes are kept, so a loop that takes several
+ * checks to come around is caught too.
+ *
+ * A ROM that read the keypad since the last check (Ex9E, ExA1, a waiting
+ * Fx0A) is waiting for input, not hung: a title screen repeats its state
+ * until a key is pressed. Such checks count as a keypad change.
+ */
+
+#define CHIP8_WATCHDOG_HISTORY (16)
+
+struct chip8_watchdog;
+typedef struct chip8_watchdog chip8_watchdog_t;
+
+struct chip8_watchdog
+{
+    chip8_t *chip8;
+    uint64_t pages[CHIP8_DIRTY_PAGES]; /* FNV-1a of each memory page */
+    uint64_t history[CHIP8_WATCHDOG_HISTORY];
+    uint32_t count;     /* hashes in history since the keypad last changed */
+    uint32_t checks;    /* total */
+    uint32_t key_reads; /* chip8_t.key_reads at the last check */
+    uint16_t keypad;
+};
+
+int chip8_watchdog_init(chip8_watchdog_t *watchdog, chip8_t *chip8);
+
+/* CHIP8_STUCK once a state repeats under the same keys, else CHIP8_OK */
+int chip8_watchdog_check(chip8_watchdog_t *watchdog);
+
+#endif /* __CHIP_8_WATCHDOG_H__ */
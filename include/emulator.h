@@ -2,16 +2,74 @@
 #define __EMULATOR_H__
 
 #include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "chip8.h"
+#include "chip8_aot.h"
+#include "chip8_cover.h"
+#include "chip8_decode.h"
+#include "chip8_perf.h"
+#include "chip8_profile.h"
+#include "chip8_stats.h"
+#include "chip8_trace.h"
+#include "chip8_watchdog.h"
+#include "framebuffer.h"
+#include "gdb.h"
 #include "io.h"
 
+#define EMULATOR_DEFAULT_FRAME_SKIP (16)
+#define EMULATOR_MAX_FRAME_SKIP     (64)
+#define EMULATOR_MAX_RUN_AHEAD      (8)
+
 typedef struct
 {
-    chip8_t chip8;
-    io_t    io;
-    char   *rom_file;
-    bool    shutdown;
+    chip8_mode_t mode;       /* instruction set the ROM was written for */
+    bool         turbo;      /* start in fast-forward */
+    unsigned int frame_skip; /* fast-forward presents every Nth frame */
+    unsigned int run_ahead;  /* frames to run ahead of the shown state */
+    uint32_t     fuse_mask;  /* decoder fusion patterns, see chip8_decode.h */
+    const char  *aot_dir;    /* compiled ROM modules, see chip8_aot.h */
+    const char  *profile;    /* collapsed stacks written here on exit */
+    const char  *gdb;        /* GDB stub socket path or loopback port */
+    const char  *trace;      /* execution trace file, see chip8_trace.h */
+    bool         perf;       /* hardware counters, see chip8_perf.h */
+    const char  *cover;      /* coverage file merged into on exit */
+    unsigned int watchdog;   /* frames between hung-ROM checks, 0 for off */
+} emulator_config_t;
+
+typedef struct
+{
+    emulator_config_t config;
+    chip8_t           chip8;
+    chip8_decoder_t   decoder;
+    chip8_aot_t       aot;
+    chip8_profile_t   profile;
+    chip8_perf_t      perf;
+    chip8_cover_t     cover;
+    chip8_watchdog_t  watchdog;
+    gdb_t             gdb;
+    chip8_trace_t     trace;
+    chip8_stats_t     stats; /* written by the io thread */
+    io_t              io;
+    char             *rom_file;
+    atomic_bool       shutdown;
+    atomic_bool       turbo;
+    pthread_t         cpu_thread;
+    framebuffer_t     framebuffer; /* cpu thread -> io thread */
+    chip8_snapshot_t  run_ahead;   /* real state while running ahead */
+    _Atomic uint64_t  executed;    /* cpu thread -> stats */
+    _Atomic uint16_t  pc;          /* cpu thread -> stats */
+    unsigned int      frames;      /* real frames since the last check */
+    int               cpu_err;     /* why the cpu thread stopped */
+
+    int epoll_fd;
+    int timer_fd;     /* 60 Hz io tick: input, presents in fast-forward */
+    int cpu_timer_fd; /* 60 Hz emulated frames, read by the cpu thread only */
+    int signal_fd;    /* SIGINT / SIGTERM */
+    int shutdown_fd;  /* eventfd, wakes the io loop for shutdown */
+    int wake_fd;      /* eventfd, wakes the cpu thread: shutdown, mode change */
+    int frame_fd;     /* eventfd, the cpu thread published a frame */
 } emulator_t;
 
 typedef enum
@@ -20,14 +78,21 @@ typedef enum
     EMULATOR_ERR,
     EMULATOR_CHIP8_INIT_ERR,
     EMULATOR_IO_INIT_ERR,
+    EMULATOR_THREAD_ERR,
+    EMULATOR_EVENT_INIT_ERR,
+    EMULATOR_GDB_INIT_ERR,
+    EMULATOR_STUCK,   /* the watchdog ended a hung ROM */
+    EMULATOR_CPU_ERR, /* the ROM stopped on a chip8 error, see cpu_err */
 } emulator_error_t;
 
-int emulator_init(emulator_t *emulator, char *rom_file);
+int emulator_init(emulator_t *emulator, char *rom_file,
+                  const emulator_config_t *config);
 
 int emulator_cycle(emulator_t *emulator);
 
 void emulator_cleanup(emulator_t *emulator);
 
+/* async-signal-safe */
 void emulator_signal_shutdown(emulator_t *emulator);
 
-#endif /* __EMULATOR_H__ */
\ No newline at end of file
+#endif /* __EMULATOR_H__ */
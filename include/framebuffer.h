@@ -0,0 +1,46 @@
+#ifndef __FRAMEBUFFER_H__
+#define __FRAMEBUFFER_H__
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "chip8.h"
+
+#define FRAMEBUFFER_COUNT (3)
+
+typedef struct
+{
+    /* packed, see chip8_display.h */
+    chip8_row_t planes[CHIP8_PLANES][CHIP8_DISPLAY_HEIGHT];
+} frame_t;
+
+/**
+ * Triple-buffered frame exchange between the emulation thread (producer)
+ * and the presenting thread (consumer).
+ *
+ * The producer owns `back`, the consumer owns `front`, and the third buffer
+ * sits in `middle`. Publishing or acquiring a frame is a single atomic
+ * exchange of `middle`, so neither side ever waits on the other: a slow
+ * consumer only means some frames are overwritten before being shown.
+ */
+struct framebuffer;
+typedef struct framebuffer framebuffer_t;
+
+struct framebuffer
+{
+    frame_t      frames[FRAMEBUFFER_COUNT];
+    atomic_uint  middle; /* buffer index, plus a flag bit while unread */
+    unsigned int back;
+    unsigned int front;
+};
+
+void framebuffer_init(framebuffer_t *fb);
+
+/* producer side */
+frame_t *framebuffer_back(framebuffer_t *fb);
+void     framebuffer_publish(framebuffer_t *fb);
+
+/* consumer side, returns NULL when no new frame was published */
+const frame_t *framebuffer_acquire(framebuffer_t *fb);
+
+#endif /* __FRAMEBUFFER_H__ */
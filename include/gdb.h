@@ -0,0 +1,108 @@
+#ifndef __GDB_H__
+#define __GDB_H__
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "chip8.h"
+#include "chip8_debug.h"
+
+/**
+ * GDB remote serial protocol stub.
+ *
+ * The stub runs on its own thread and serves one debugger at a time over
+ * a Unix socket (any address containing a '/') or a loopback TCP port.
+ * It only reaches into the machine while the cpu thread is parked:
+ * - Stop requests go through the atomic `halt` flag, which the cpu thread
+ *   tests once per batch. With no debugger attached, that single load is
+ *   the whole cost.
+ * - A parked cpu thread hands control back and forth under `lock`.
+ *
+ * Registers, in `g` packet order, big endian like the machine itself:
+ * V0-VF (8 bit), I, PC, SP (16 bit), DT, ST (8 bit). Target memory is the
+ * address space the mode can see, 4 KB or 64 KB for XO-CHIP.
+ */
+
+#define GDB_PACKET_SIZE (4096)
+
+typedef void (*gdb_kill_handler)(void *ctx);
+
+typedef enum
+{
+    GDB_RESUME_NONE = 0,
+    GDB_RESUME_STEP,
+    GDB_RESUME_CONTINUE,
+} gdb_resume_t;
+
+struct gdb;
+typedef struct gdb gdb_t;
+
+struct gdb
+{
+    chip8_t      *chip8;
+    chip8_debug_t debug;
+
+    gdb_kill_handler kill;
+    void            *kill_ctx;
+
+    int       listen_fd;
+    int       client_fd;
+    int       wake_fd; /* eventfd: the cpu thread stopped, or shutdown */
+    pthread_t thread;
+    bool      started;
+
+    /* cpu thread: stop at the next batch boundary */
+    atomic_bool halt;
+    atomic_bool shutdown;
+
+    /* handoff with the parked cpu thread */
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    bool            halted; /* parked, and not yet told to resume */
+    gdb_resume_t    resume;
+    int             signal;    /* why the cpu thread stopped */
+    bool            interrupt; /* the stop was a ^C from the debugger */
+
+    /* session state, gdb thread only */
+    bool   running; /* a stop reply is owed for c/s */
+    bool   noack;
+    bool   detach;
+    int    rx_state;
+    int    rx_checksum;
+    size_t length;
+    char   packet[GDB_PACKET_SIZE];
+};
+
+typedef enum
+{
+    GDB_OK = 0,
+    GDB_SOCKET_ERR,
+    GDB_THREAD_ERR,
+    GDB_MAX, /* must be last one */
+} gdb_error_code_t;
+
+/**
+ * Listen on `address` and start the stub thread. The cpu thread starts
+ * parked, so the ROM does not run before the debugger has had a look.
+ * `kill` is called when the debugger asks to end the session.
+ */
+int gdb_init(gdb_t *gdb, chip8_t *chip8, const char *address,
+             gdb_kill_handler kill, void *ctx);
+
+/* cpu thread: called at a batch boundary when a halt or CHIP8_BREAK is due */
+static inline bool gdb_halt_requested(gdb_t *gdb, int err)
+{
+    return err == CHIP8_BREAK ||
+           atomic_load_explicit(&gdb->halt, memory_order_acquire);
+}
+
+/* cpu thread: park until the debugger continues, stepping on request */
+void gdb_stop(gdb_t *gdb, int err);
+
+/* release a parked cpu thread for good, before it is joined */
+void gdb_shutdown(gdb_t *gdb);
+
+void gdb_cleanup(gdb_t *gdb);
+
+#endif /* __GDB_H__ */
@@ -1,7 +1,12 @@
 #ifndef __IO_H__
 #define __IO_H__
 
+#include <stdint.h>
+
 #include "SDL.h" // IWYU pragma: keep
+#include "framebuffer.h"
+
+#define IO_KEY_NONE (0xFF)
 
 struct io;
 typedef struct io io_t;
@@ -12,6 +17,9 @@ struct io
     io_cycle_handler cycle_handler;
     int              scale;
     SDL_Window      *window;
+    SDL_Renderer    *renderer;
+    SDL_Texture     *texture;
+    chip8_t         *chip8; /* keypad updates are published straight in */
 };
 
 typedef enum
@@ -19,11 +27,14 @@ typedef enum
     IO_OK = 0,
     IO_SDL_INIT_ERROR,
     IO_WINDOW_CREATE_ERROR,
+    IO_RENDERER_CREATE_ERROR,
     IO_QUIT,
+    IO_TURBO_TOGGLE,
     IO_MAX, /* must be last one */
 } io_error_code_t;
 
 int  io_init(io_t *io, int width, int height);
+void io_present(io_t *io, const frame_t *frame);
 void io_cleanup(io_t *io);
 
-#endif /* __IO_H__ */
\ No newline at end of file
+#endif /* __IO_H__ */
@@ -1,38 +1,152 @@
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
-#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include "emulator.h"
 
-static emulator_t emulator = { 0 };
+#if defined(CHIP8_PROFILE)
+#define USAGE_PROFILE                                                          \
+    "  -p file    profile subroutines, collapsed stacks to file\n"
+#else
+#define USAGE_PROFILE ""
+#endif
 
-void handle_signal(int signal)
+static void usage(const char *prog)
 {
-    (void)signal;
-    emulator_signal_shutdown(&emulator);
+    fprintf(stderr,
+            "Usage: %s [-m mode] [-a dir] [-f list] [-t]\n"
+            "          [-s frames] [-r frames] <path to ROM>\n"
+            "  -m mode    chip8, schip or xo (default chip8)\n"
+            "  -a dir     run the ROM's chip8-aot module from dir, if any\n"
+            "  -f list    fused instruction patterns, comma separated, or\n"
+            "             all / none (default all): load-draw, load-load,\n"
+            "             count-loop\n"
+            "  -t         start in fast-forward (toggle with Tab)\n"
+            "  -s frames  fast-forward presents every Nth frame (1-%d,\n"
+            "             default %d)\n"
+            "  -r frames  run ahead to hide input lag (0-%d, default 0)\n"
+            "  -g addr    wait for GDB on a socket path or loopback port\n"
+            "  -T file    trace every instruction to file (see chip8-trace)\n"
+            "  -P         report host perf counters per emulated instruction\n"
+            "  -C file    merge code coverage into file (see chip8-cover)\n"
+            "  -w frames  end a ROM whose state repeats, checked every N\n"
+            "             frames (exit status %d)\n"
+            "%s",
+            prog, EMULATOR_MAX_FRAME_SKIP, EMULATOR_DEFAULT_FRAME_SKIP,
+            EMULATOR_MAX_RUN_AHEAD, EMULATOR_STUCK, USAGE_PROFILE);
+}
+
+/* a whole decimal, hex or octal number in [min, max], nothing else */
+static int parse_count(const char *arg, unsigned long min, unsigned long max,
+                       unsigned int *value)
+{
+    char         *end;
+    unsigned long n;
+
+    if (!isdigit((unsigned char)*arg)) {
+        return -1;
+    }
+
+    errno = 0;
+    n     = strtoul(arg, &end, 0);
+    if (errno || *end != '\0' || n < min || n > max) {
+        return -1;
+    }
+
+    *value = n;
+
+    return 0;
 }
 
 int main(int argc, char **argv)
 {
-    int   err = 0;
-    char *rom = NULL;
+    static emulator_t emulator = { 0 };
+    emulator_config_t config   = { 0 };
+    int               err      = 0;
+    int               opt;
+    char             *rom = NULL;
 
-    signal(SIGINT, handle_signal);
+    config.frame_skip = EMULATOR_DEFAULT_FRAME_SKIP;
+    config.fuse_mask  = CHIP8_FUSE_ALL;
 
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <path to ROM>\n", argv[0]);
-        return 1;
+    while ((opt = getopt(argc, argv, "m:a:f:ts:r:p:g:T:PC:w:")) != -1) {
+        switch (opt) {
+        case 'm':
+            if (chip8_mode_parse(optarg, &config.mode) != CHIP8_OK) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'a':
+            config.aot_dir = optarg;
+            break;
+        case 'f':
+            if (chip8_fuse_parse(optarg, &config.fuse_mask) != CHIP8_OK) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 't':
+            config.turbo = true;
+            break;
+        case 's':
+            if (parse_count(optarg, 1, EMULATOR_MAX_FRAME_SKIP, &config.frame_skip) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'r':
+            if (parse_count(optarg, 0, EMULATOR_MAX_RUN_AHEAD, &config.run_ahead) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'g':
+            config.gdb = optarg;
+            break;
+        case 'T':
+            config.trace = optarg;
+            break;
+        case 'P':
+            config.perf = true;
+            break;
+        case 'C':
+            config.cover = optarg;
+            break;
+        case 'w':
+            if (parse_count(optarg, 0, UINT_MAX, &config.watchdog) != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+#if defined(CHIP8_PROFILE)
+        case 'p':
+            config.profile = optarg;
+            break;
+#endif
+        default:
+            usage(argv[0]);
+            return 1;
+        }
     }
 
-    rom = argv[1];
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
 
+    rom = argv[optind];
 
+    err = emulator_init(&emulator, rom, &config);
     if (err != EMULATOR_SUCCESS) {
-        err = emulator_init(&emulator, rom);
         goto out;
     }
 
-    emulator_cycle(&emulator);
+    err = emulator_cycle(&emulator);
 
 out:
     emulator_cleanup(&emulator);
     return err;
-}
\ No newline at end of file
+}
@@ -3,13 +3,60 @@
 #include <fcntl.h>
 #include <time.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "chip8.h"
+#include "chip8_code.h"
+#include "chip8_log.h"
+#include "chip8_profile.h"
+#include "chip8_trace.h"
 
 static int            chip8_cycle(chip8_t *chip8);
 extern decode_handler handlers[];
 
+static const uint8_t chip8_font[CHIP8_FONT_CHARACTERS][CHIP8_FONT_SIZE] = {
+    { 0xF0, 0x90, 0x90, 0x90, 0xF0 }, /* 0 */
+    { 0x20, 0x60, 0x20, 0x20, 0x70 }, /* 1 */
+    { 0xF0, 0x10, 0xF0, 0x80, 0xF0 }, /* 2 */
+    { 0xF0, 0x10, 0xF0, 0x10, 0xF0 }, /* 3 */
+    { 0x90, 0x90, 0xF0, 0x10, 0x10 }, /* 4 */
+    { 0xF0, 0x80, 0xF0, 0x10, 0xF0 }, /* 5 */
+    { 0xF0, 0x80, 0xF0, 0x90, 0xF0 }, /* 6 */
+    { 0xF0, 0x10, 0x20, 0x40, 0x40 }, /* 7 */
+    { 0xF0, 0x90, 0xF0, 0x90, 0xF0 }, /* 8 */
+    { 0xF0, 0x90, 0xF0, 0x10, 0xF0 }, /* 9 */
+    { 0xF0, 0x90, 0xF0, 0x90, 0x90 }, /* A */
+    { 0xE0, 0x90, 0xE0, 0x90, 0xE0 }, /* B */
+    { 0xF0, 0x80, 0x80, 0x80, 0xF0 }, /* C */
+    { 0xE0, 0x90, 0x90, 0x90, 0xE0 }, /* D */
+    { 0xF0, 0x80, 0xF0, 0x80, 0xF0 }, /* E */
+    { 0xF0, 0x80, 0xF0, 0x80, 0x80 }, /* F */
+};
+
+static const uint8_t chip8_big_font[CHIP8_FONT_CHARACTERS]
+                                   [CHIP8_BIG_FONT_SIZE] = {
+    { 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF }, /* 0 */
+    { 0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF }, /* 1 */
+    { 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF }, /* 2 */
+    { 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF }, /* 3 */
+    { 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03 }, /* 4 */
+    { 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF }, /* 5 */
+    { 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF }, /* 6 */
+    { 0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18 }, /* 7 */
+    { 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF }, /* 8 */
+    { 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF }, /* 9 */
+    { 0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3 }, /* A */
+    { 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC }, /* B */
+    { 0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C }, /* C */
+    { 0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC }, /* D */
+    { 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF }, /* E */
+    { 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0 }, /* F */
+};
+
 static int chip8_load_rom(chip8_t *chip8, const char *rom_file)
 {
     FILE       *fd = NULL;
@@ -22,7 +69,7 @@ static int chip8_load_rom(chip8_t *chip8, const char *rom_file)
         return CHIP8_ROM_ERR;
     }
 
-    if (st.st_size > CHIP8_MAX_ROM_SIZE) {
+    if (st.st_size > CHIP8_MAX_ROM_SIZE(chip8)) {
         return CHIP8_ROM_TOO_BIG_ERR;
     }
 
@@ -36,15 +83,62 @@ static int chip8_load_rom(chip8_t *chip8, const char *rom_file)
         err = CHIP8_ROM_READ_ERR;
     }
 
+    chip8->rom_size = st.st_size;
+    chip8->rom_hash = chip8_fnv1a(CHIP8_FNV_OFFSET,
+                                  &chip8->memory[CHIP8_ROM_START], st.st_size);
+
     fclose(fd);
     return err;
 }
 
-int chip8_init(chip8_t *chip8, const char *rom_file)
+static const char *chip8_modes[CHIP8_MODE_MAX] = {
+    [CHIP8_MODE_CHIP8]  = "chip8",
+    [CHIP8_MODE_SCHIP]  = "schip",
+    [CHIP8_MODE_XOCHIP] = "xo",
+};
+
+int chip8_mode_parse(const char *name, chip8_mode_t *mode)
 {
-    srand(time(NULL));
+    for (int i = 0; i < CHIP8_MODE_MAX; i++) {
+        if (strcmp(name, chip8_modes[i]) == 0) {
+            *mode = i;
+            return CHIP8_OK;
+        }
+    }
+
+    return CHIP8_ERR;
+}
+
+const char *chip8_mode_name(chip8_mode_t mode)
+{
+    return mode < CHIP8_MODE_MAX ? chip8_modes[mode] : NULL;
+}
+
+int chip8_init(chip8_t *chip8, const char *rom_file, chip8_mode_t mode)
+{
+    if (mode >= CHIP8_MODE_MAX) {
+        return CHIP8_ERR;
+    }
+
+    memset(chip8, 0, sizeof(chip8_t));
+    atomic_init(&chip8->keypad, 0);
+    chip8->mode            = mode;
+    chip8->memory_mask     = CHIP8_MEMORY_MASK_CLASSIC;
+    chip8->rng             = (uint32_t)time(NULL) | 1;
+    chip8->planes          = 0x1;
+    chip8->pitch           = CHIP8_AUDIO_PITCH;
     chip8->program_counter = CHIP8_ROM_START;
     chip8->cycle_handler   = chip8_cycle;
+    chip8->run_handler     = chip8_interpret;
+
+    if (mode == CHIP8_MODE_XOCHIP) {
+        chip8->memory_mask = CHIP8_MEMORY_MASK_XOCHIP;
+    }
+
+    memcpy(&chip8->memory[CHIP8_FONT_START], chip8_font, sizeof(chip8_font));
+    memcpy(&chip8->memory[CHIP8_BIG_FONT_START], chip8_big_font,
+           sizeof(chip8_big_font));
+
     return chip8_load_rom(chip8, rom_file);
 }
 
@@ -53,38 +147,207 @@ static int chip8_fetch_decode_execute(chip8_t *chip8)
     int      err     = CHIP8_OK;
     uint16_t command = 0;
     uint8_t  opcode  = 0;
-    int      jump    = 0;
+    uint16_t pc;
 
     CHIP8_ASSERT_PTR(chip8, CHIP8_INVALID_PTR_ERR);
 
+    pc = chip8->program_counter;
+
     /* get the first half of the instruction and left shift it by 8 */
     command = CHIP8_MEM(chip8, chip8->program_counter) << 8;
     /* append the second half of the command */
-    command &= CHIP8_MEM(chip8, chip8->program_counter + 1);
+    command |= CHIP8_MEM(chip8, chip8->program_counter + 1);
 
-    printf("command: %x\n", command);
+    CHIP8_LOG_TRACE("%03x: %04x", pc, command);
 
     /* opcode is the MSB (0xF000) */
-    opcode = command & CHIP8_NIBBLE_MASK(4);
+    opcode = CHIP8_NIBBLE(command, 4);
 
-    if (opcode < 0x00 || opcode > 0xF0 || !handlers[opcode]) {
+    if (!handlers[opcode]) {
+        CHIP8_TRACE(chip8, pc, command, CHIP8_OPCODE_ERR);
         return CHIP8_OPCODE_ERR;
     }
 
-    err = handlers[opcode](chip8, command);
+    /**
+     * advance past the fetched instruction before executing it, so jumps,
+     * calls and skips only ever have to write their own target.
+     */
+    chip8->program_counter += 2;
 
-    if (!jump) {
-        chip8->program_counter += 2;
-    }
+    CHIP8_PROFILE_RETIRE(chip8);
+    err = handlers[opcode](chip8, command);
+    CHIP8_TRACE(chip8, pc, command, err);
 
     return err;
 }
 
+/**
+ * Execute an already fetched instruction located at the program counter,
+ * for engines that did the fetch and decode themselves.
+ */
+int chip8_execute(chip8_t *chip8, uint16_t command)
+{
+    chip8->program_counter += 2;
+
+    return handlers[CHIP8_NIBBLE(command, 4)](chip8, command);
+}
+
 static int chip8_cycle(chip8_t *chip8)
 {
     return chip8_fetch_decode_execute(chip8);
 }
 
+int chip8_run(chip8_t *chip8, unsigned int cycles, unsigned int *executed)
+{
+    int err;
+
+    CHIP8_ASSERT_PTR(chip8, CHIP8_INVALID_PTR_ERR);
+
+    err = chip8->run_handler(chip8, cycles, executed);
+
+    /**
+     * calls and returns only record a fault, the batch boundary is where
+     * it is reported. The flag is sticky, so the ROM stays stopped.
+     */
+    if (err == CHIP8_OK && chip8->stack_fault) {
+        err = CHIP8_INVALID_STACK_PTR_ERR;
+        if (chip8->trace) {
+            chip8_trace_dump(chip8->trace);
+        }
+    }
+
+    return err;
+}
+
+/* the reference engine: fetch, decode and execute one instruction a time */
+int chip8_interpret(chip8_t *chip8, unsigned int cycles,
+                    unsigned int *executed)
+{
+    int          err   = CHIP8_OK;
+    unsigned int count = 0;
+
+    CHIP8_ASSERT_PTR(chip8, CHIP8_INVALID_PTR_ERR);
+
+    while (count < cycles && err == CHIP8_OK) {
+        err = chip8->cycle_handler(chip8);
+        count++;
+    }
+
+    if (executed) {
+        *executed = count;
+    }
+
+    return err;
+}
+
+/* memory is last, so classic ROMs never pay for the 60 KB they cannot see */
+void chip8_save_state(const chip8_t *chip8, chip8_snapshot_t *snapshot)
+{
+    memcpy(snapshot->data, (const uint8_t *)chip8 + CHIP8_STATE_OFFSET,
+           CHIP8_STATE_USED(chip8));
+    snapshot->code_generation = chip8->code_generation;
+    snapshot->code_marks      = chip8->code_marks;
+}
+
+/**
+ * If code was rewritten since the snapshot was taken, the restore silently
+ * puts the old bytes back under whatever was decoded since, so every
+ * cached translation is dropped. The same goes for code decoded since: it
+ * may have been decoded from bytes a later store wrote into a line that
+ * was not marked yet, which bumped no generation.
+ */
+void chip8_load_state(chip8_t *chip8, const chip8_snapshot_t *snapshot)
+{
+    memcpy((uint8_t *)chip8 + CHIP8_STATE_OFFSET, snapshot->data,
+           CHIP8_STATE_USED(chip8));
+
+    /* any page may differ now */
+    memset(chip8->dirty_map, 0xFF, sizeof(chip8->dirty_map));
+
+    if (snapshot->code_generation != chip8->code_generation ||
+        snapshot->code_marks != chip8->code_marks) {
+        chip8_code_reset(chip8);
+    }
+}
+
+void chip8_tick_timers(chip8_t *chip8)
+{
+    if (chip8->delay_timer > 0) {
+        chip8->delay_timer--;
+    }
+
+    if (chip8->sound_timer > 0) {
+        chip8->sound_timer--;
+    }
+}
+
+uint16_t chip8_keypad(chip8_t *chip8)
+{
+    return atomic_load_explicit(&chip8->keypad, memory_order_acquire) &
+           CHIP8_KEYPAD_MASK;
+}
+
+static long chip8_futex(_Atomic uint32_t *addr, int op, uint32_t value,
+                        const struct timespec *timeout)
+{
+    return syscall(SYS_futex, addr, op, value, timeout, NULL, 0);
+}
+
+/**
+ * Publish a key transition with a single atomic read-modify-write. The
+ * wake syscall is only paid when the cpu thread actually parked on Fx0A,
+ * which it advertises through CHIP8_KEYPAD_WAITING in the same word.
+ */
+void chip8_keypad_set(chip8_t *chip8, uint8_t key, chip8_key_state_t state)
+{
+    uint32_t bit = (1u << key) & CHIP8_KEYPAD_MASK;
+    uint32_t old;
+
+    if (state == CHIP8_KEY_PRESSED) {
+        old = atomic_fetch_or_explicit(&chip8->keypad, bit,
+                                       memory_order_release);
+    } else {
+        old = atomic_fetch_and_explicit(&chip8->keypad, ~bit,
+                                        memory_order_release);
+    }
+
+    if (old & CHIP8_KEYPAD_WAITING) {
+        atomic_fetch_and_explicit(&chip8->keypad, ~CHIP8_KEYPAD_WAITING,
+                                  memory_order_relaxed);
+        chip8_futex(&chip8->keypad, FUTEX_WAKE_PRIVATE, 1, NULL);
+    }
+}
+
+/**
+ * Park the calling thread until the keypad differs from `keys` or the
+ * timeout expires. Returns CHIP8_OK on a keypad change, CHIP8_KEY_WAIT on
+ * timeout.
+ */
+int chip8_keypad_wait(chip8_t *chip8, uint16_t keys, long timeout_nsec)
+{
+    struct timespec timeout = {
+        .tv_sec  = timeout_nsec / 1000000000L,
+        .tv_nsec = timeout_nsec % 1000000000L,
+    };
+    uint32_t        value;
+
+    value = atomic_fetch_or_explicit(&chip8->keypad, CHIP8_KEYPAD_WAITING,
+                                     memory_order_acquire);
+    if ((value & CHIP8_KEYPAD_MASK) != keys) {
+        return CHIP8_OK;
+    }
+
+    if (chip8_futex(&chip8->keypad, FUTEX_WAIT_PRIVATE,
+                    value | CHIP8_KEYPAD_WAITING, &timeout) != 0 &&
+        errno == ETIMEDOUT) {
+        atomic_fetch_and_explicit(&chip8->keypad, ~CHIP8_KEYPAD_WAITING,
+                                  memory_order_relaxed);
+        return CHIP8_KEY_WAIT;
+    }
+
+    return CHIP8_OK;
+}
+
 void chip8_cleanup(chip8_t *chip8)
 {
     (void)chip8;
@@ -0,0 +1,172 @@
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "chip8_aot.h"
+#include "chip8_code.h"
+
+int chip8_aot_path(char *path, size_t len, const char *dir, uint64_t rom_hash,
+                   chip8_mode_t mode)
+{
+    int n = snprintf(path, len, "%s/%016llx-%u.so", dir,
+                     (unsigned long long)rom_hash, (unsigned int)mode);
+
+    return n < 0 || (size_t)n >= len ? CHIP8_ERR : CHIP8_OK;
+}
+
+/**
+ * The marks are per line and shared with whatever block the line also
+ * holds, so once any block re-marks a line they no longer say whether
+ * another one was written over. A store into a marked line flags every
+ * block it overlaps instead.
+ */
+static void chip8_aot_invalidate(void *ctx, uint16_t address, uint32_t len)
+{
+    chip8_aot_t *aot = ctx;
+
+    for (uint32_t i = 0; i < aot->module->count; i++) {
+        const chip8_aot_block_t *block = &aot->module->blocks[i];
+
+        if (block->address < address + len &&
+            address < block->address + block->bytes) {
+            aot->stale[block->address] = 1;
+        }
+    }
+}
+
+/**
+ * A flagged block was written over. Most of the time the write left its
+ * bytes alone (data next to code, or a snapshot restore putting them
+ * back), so compare before giving up on it.
+ */
+static int chip8_aot_live(chip8_aot_t *aot, const chip8_aot_block_t *block)
+{
+    chip8_t *chip8 = aot->chip8;
+
+    if (!aot->stale[block->address]) {
+        return 1;
+    }
+
+    if (memcmp(&chip8->memory[block->address],
+               &aot->module->code[block->code], block->bytes) != 0) {
+        return 0;
+    }
+
+    aot->stale[block->address] = 0;
+    chip8_code_mark(chip8, block->address, block->bytes);
+
+    return 1;
+}
+
+static int chip8_aot_run(chip8_t *chip8, unsigned int cycles,
+                         unsigned int *executed)
+{
+    chip8_aot_t             *aot = chip8->run_ctx;
+    const chip8_aot_block_t *block;
+    int                      err   = CHIP8_OK;
+    unsigned int             count = 0;
+    unsigned int             retired;
+
+    while (count < cycles && err == CHIP8_OK) {
+        block = aot->table[chip8->program_counter & chip8->memory_mask];
+
+        if (block && chip8_aot_live(aot, block)) {
+            err = block->run(chip8, chip8_execute, cycles - count, &retired);
+        } else {
+            err = chip8_interpret(chip8, 1, &retired);
+        }
+
+        count += retired;
+    }
+
+    if (executed) {
+        *executed = count;
+    }
+
+    return err;
+}
+
+static int chip8_aot_valid(const chip8_aot_module_t *module,
+                           const chip8_t *chip8)
+{
+    if (module->version != CHIP8_AOT_VERSION ||
+        module->state_size != sizeof(chip8_t) ||
+        module->rom_hash != chip8->rom_hash || module->mode != chip8->mode) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < module->count; i++) {
+        const chip8_aot_block_t *block = &module->blocks[i];
+
+        if (block->bytes == 0 ||
+            block->address + block->bytes > chip8->memory_mask + 1u) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int chip8_aot_init(chip8_aot_t *aot, chip8_t *chip8, const char *dir)
+{
+    char path[4096];
+
+    CHIP8_ASSERT_PTR(aot, CHIP8_INVALID_PTR_ERR);
+    CHIP8_ASSERT_PTR(chip8, CHIP8_INVALID_PTR_ERR);
+    CHIP8_ASSERT_PTR(dir, CHIP8_INVALID_PTR_ERR);
+
+    memset(aot, 0, sizeof(*aot));
+
+    if (chip8_aot_path(path, sizeof(path), dir, chip8->rom_hash,
+                       chip8->mode) != CHIP8_OK) {
+        return CHIP8_ERR;
+    }
+
+    aot->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!aot->handle) {
+        return CHIP8_ROM_ERR;
+    }
+
+    aot->module = dlsym(aot->handle, CHIP8_AOT_SYMBOL);
+    if (!aot->module || !chip8_aot_valid(aot->module, chip8)) {
+        chip8_aot_cleanup(aot);
+        return CHIP8_ROM_ERR;
+    }
+
+    for (uint32_t i = 0; i < aot->module->count; i++) {
+        const chip8_aot_block_t *block = &aot->module->blocks[i];
+
+        aot->table[block->address] = block;
+        chip8_code_mark(chip8, block->address, block->bytes);
+    }
+
+    if (chip8_code_watch(chip8, chip8_aot_invalidate, aot) != CHIP8_OK) {
+        chip8_aot_cleanup(aot);
+        return CHIP8_ERR;
+    }
+
+    aot->chip8         = chip8;
+    chip8->run_handler = chip8_aot_run;
+    chip8->run_ctx     = aot;
+
+    return CHIP8_OK;
+}
+
+void chip8_aot_cleanup(chip8_aot_t *aot)
+{
+    if (aot->chip8) {
+        chip8_code_unwatch(aot->chip8, chip8_aot_invalidate, aot);
+    }
+    if (aot->chip8 && aot->chip8->run_ctx == aot) {
+        aot->chip8->run_handler = chip8_interpret;
+        aot->chip8->run_ctx     = NULL;
+    }
+
+    if (aot->handle) {
+        dlclose(aot->handle);
+    }
+
+    aot->handle = NULL;
+    aot->module = NULL;
+    aot->chip8  = NULL;
+}
@@ -0,0 +1,94 @@
+#include "chip8_code.h"
+
+static void chip8_code_lines(chip8_t *chip8, uint16_t address, uint32_t len,
+                             int set)
+{
+    uint32_t line  = CHIP8_CODE_LINE(chip8, address);
+    uint32_t count = ((address & CHIP8_CODE_LINE_MASK) + len +
+                      CHIP8_CODE_LINE_MASK) >>
+                     CHIP8_CODE_LINE_SHIFT;
+    uint32_t lines = (chip8->memory_mask >> CHIP8_CODE_LINE_SHIFT) + 1;
+
+    if (count > lines) {
+        count = lines;
+    }
+
+    /* a range running past the top of memory wraps, like the store did */
+    for (uint32_t i = 0; i < count; i++, line = (line + 1) % lines) {
+        if (set) {
+            chip8->code_map[line >> 6] |= 1ull << (line & 63);
+        } else {
+            chip8->code_map[line >> 6] &= ~(1ull << (line & 63));
+        }
+    }
+}
+
+void chip8_code_mark(chip8_t *chip8, uint16_t address, uint32_t len)
+{
+    if (len) {
+        chip8_code_lines(chip8, address, len, 1);
+        chip8->code_marks++;
+    }
+}
+
+/**
+ * The marks are per line, so once a line's bit is cleared nothing may
+ * stay cached for any byte of it: watchers get the range widened to whole
+ * lines.
+ */
+void chip8_code_invalidate(chip8_t *chip8, uint16_t address, uint32_t len)
+{
+    uint32_t size = chip8->memory_mask + 1;
+
+    len += address & CHIP8_CODE_LINE_MASK;
+    len = (len + CHIP8_CODE_LINE_MASK) & ~CHIP8_CODE_LINE_MASK;
+    if (len > size) {
+        len = size;
+    }
+    address &= chip8->memory_mask & ~CHIP8_CODE_LINE_MASK;
+
+    chip8_code_lines(chip8, address, len, 0);
+    chip8->code_generation++;
+
+    for (int i = 0; i < CHIP8_CODE_WATCHERS; i++) {
+        if (chip8->code_watchers[i].handler) {
+            chip8->code_watchers[i].handler(chip8->code_watchers[i].ctx,
+                                            address, len);
+        }
+    }
+}
+
+/* drop every mark, for when memory changed behind the store paths' back */
+void chip8_code_reset(chip8_t *chip8)
+{
+    chip8_code_invalidate(chip8, 0, chip8->memory_mask + 1);
+}
+
+int chip8_code_watch(chip8_t *chip8, chip8_invalidate_handler handler,
+                     void *ctx)
+{
+    CHIP8_ASSERT_PTR(chip8, CHIP8_INVALID_PTR_ERR);
+    CHIP8_ASSERT_PTR(handler, CHIP8_INVALID_PTR_ERR);
+
+    for (int i = 0; i < CHIP8_CODE_WATCHERS; i++) {
+        if (!chip8->code_watchers[i].handler) {
+            chip8->code_watchers[i].handler = handler;
+            chip8->code_watchers[i].ctx     = ctx;
+            return CHIP8_OK;
+        }
+    }
+
+    return CHIP8_ERR;
+}
+
+void chip8_code_unwatch(chip8_t *chip8, chip8_invalidate_handler handler,
+                        void *ctx)
+{
+    for (int i = 0; i < CHIP8_CODE_WATCHERS; i++) {
+        if (chip8->code_watchers[i].handler == handler &&
+            chip8->code_watchers[i].ctx == ctx) {
+            chip8->code_watchers[i].handler = NULL;
+            chip8->code_watchers[i].ctx     = NULL;
+        }
+    }
+}
@@ -0,0 +1,328 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include "chip8_cover.h"
+#include "chip8_disasm.h"
+
+typedef enum
+{
+    CHIP8_COVER_STRAIGHT = 0, /* falls through to the next instruction */
+    CHIP8_COVER_BRANCH,       /* ends a block */
+    CHIP8_COVER_SKIP,         /* ends a block, outcome recorded */
+} chip8_cover_kind_t;
+
+/* leading nibbles of opcodes that can end a block: 0-5, 9, B, E, F */
+#define CHIP8_COVER_ENDS (0xCA3F)
+
+static int chip8_cover_run(chip8_t *chip8, unsigned int cycles,
+                           unsigned int *executed);
+
+static inline chip8_cover_kind_t chip8_cover_kind(uint16_t command)
+{
+    switch (CHIP8_NIBBLE(command, 4)) {
+    case 0x0:
+        /* 00EE returns, 00FD exits */
+        return command == 0x00EE || command == 0x00FD ? CHIP8_COVER_BRANCH
+                                                      : CHIP8_COVER_STRAIGHT;
+    case 0x1:
+    case 0x2:
+    case 0xB:
+        return CHIP8_COVER_BRANCH;
+    case 0x3:
+    case 0x4:
+        return CHIP8_COVER_SKIP;
+    case 0x5:
+    case 0x9:
+        return (command & 0xF) == 0 ? CHIP8_COVER_SKIP : CHIP8_COVER_STRAIGHT;
+    case 0xE:
+        return (command & 0xFF) == 0x9E || (command & 0xFF) == 0xA1
+                   ? CHIP8_COVER_SKIP
+                   : CHIP8_COVER_STRAIGHT;
+    case 0xF:
+        /* Fx0A waits, F000 nnnn is four bytes long */
+        return (command & 0xFF) == 0x0A || command == 0xF000
+                   ? CHIP8_COVER_BRANCH
+                   : CHIP8_COVER_STRAIGHT;
+    default:
+        return CHIP8_COVER_STRAIGHT;
+    }
+}
+
+static inline void chip8_cover_set(chip8_cover_t *cover, chip8_cover_map_t map,
+                                   uint16_t address)
+{
+    cover->map[map][address >> 6] |= 1ULL << (address & 63);
+}
+
+/* set `len` bytes from `address` on, wrapping at the end of memory */
+static void chip8_cover_mark_range(chip8_cover_t *cover, uint16_t address,
+                                   uint32_t len)
+{
+    uint64_t *map  = cover->map[CHIP8_COVER_EXECUTED];
+    uint32_t  mask = cover->chip8->memory_mask;
+    uint32_t  bit;
+    uint32_t  n;
+
+    if (len > mask + 1) {
+        len = mask + 1;
+    }
+
+    while (len > 0) {
+        bit = address & 63;
+        n   = 64 - bit < len ? 64 - bit : len;
+        n   = mask + 1 - address < n ? mask + 1 - address : n;
+
+        map[address >> 6] |= (n == 64 ? ~0ULL : ((1ULL << n) - 1)) << bit;
+
+        address = (address + n) & mask;
+        len -= n;
+    }
+}
+
+/* most blocks are short and sit inside one word */
+static inline void chip8_cover_mark(chip8_cover_t *cover, uint16_t address,
+                                    uint32_t len)
+{
+    uint32_t bit = address & 63;
+
+    if (bit + len < 64) {
+        cover->map[CHIP8_COVER_EXECUTED][address >> 6] |= ((1ULL << len) - 1)
+                                                          << bit;
+    } else {
+        chip8_cover_mark_range(cover, address, len);
+    }
+}
+
+int chip8_cover_init(chip8_cover_t *cover, chip8_t *chip8)
+{
+    CHIP8_ASSERT_PTR(cover, CHIP8_INVALID_PTR_ERR);
+    CHIP8_ASSERT_PTR(chip8, CHIP8_INVALID_PTR_ERR);
+
+    memset(cover, 0, sizeof(chip8_cover_t));
+    cover->chip8       = chip8;
+    cover->run_handler = chip8->run_handler;
+    cover->run_ctx     = chip8->run_ctx;
+    chip8->run_handler = chip8_cover_run;
+    chip8->run_ctx     = cover;
+
+    return CHIP8_OK;
+}
+
+void chip8_cover_cleanup(chip8_cover_t *cover)
+{
+    if (cover->chip8 && cover->chip8->run_ctx == cover) {
+        cover->chip8->run_handler = cover->run_handler;
+        cover->chip8->run_ctx     = cover->run_ctx;
+    }
+    cover->chip8 = NULL;
+}
+
+/**
+ * The interpreter loop, except that a block's bytes are only marked when
+ * it ends, at a branch, an error or the end of the batch.
+ */
+static int chip8_cover_run(chip8_t *chip8, unsigned int cycles,
+                           unsigned int *executed)
+{
+    chip8_cover_t     *cover = chip8->run_ctx;
+    int                err   = CHIP8_OK;
+    unsigned int       count = 0;
+    uint16_t           start = chip8->program_counter & chip8->memory_mask;
+    uint16_t           address;
+    uint16_t           command;
+    uint32_t           len = 0;
+    chip8_cover_kind_t kind;
+
+    while (count < cycles && err == CHIP8_OK) {
+        address = chip8->program_counter & chip8->memory_mask;
+        command = (CHIP8_MEM(chip8, address) << 8) |
+                  CHIP8_MEM(chip8, address + 1);
+
+        err = chip8_execute(chip8, command);
+        count++;
+        len += 2;
+
+        if (!((CHIP8_COVER_ENDS >> CHIP8_NIBBLE(command, 4)) & 1)) {
+            continue;
+        }
+        kind = chip8_cover_kind(command);
+        if (kind == CHIP8_COVER_STRAIGHT) {
+            continue;
+        }
+
+        if (command == CHIP8_LONG_LOAD && chip8->mode == CHIP8_MODE_XOCHIP) {
+            len += 2;
+        }
+        chip8_cover_mark(cover, start, len);
+
+        if (kind == CHIP8_COVER_SKIP && err == CHIP8_OK) {
+            chip8_cover_set(cover,
+                            (chip8->program_counter & chip8->memory_mask) !=
+                                    ((address + 2) & chip8->memory_mask)
+                                ? CHIP8_COVER_TAKEN
+                                : CHIP8_COVER_NOT_TAKEN,
+                            address);
+        }
+
+        start = chip8->program_counter & chip8->memory_mask;
+        len   = 0;
+    }
+
+    if (len) {
+        chip8_cover_mark(cover, start, len);
+    }
+
+    if (executed) {
+        *executed = count;
+    }
+
+    return err;
+}
+
+static int chip8_cover_merge(chip8_cover_t *cover, int fd)
+{
+    chip8_cover_file_t file;
+    uint64_t           words[CHIP8_COVER_WORDS];
+    const chip8_t     *chip8 = cover->chip8;
+    ssize_t            size  = pread(fd, &file, sizeof(file), 0);
+
+    if (size == 0) {
+        return CHIP8_ROM_READ_ERR;
+    }
+    if (size != sizeof(file) ||
+        memcmp(file.magic, CHIP8_COVER_MAGIC, sizeof(file.magic)) != 0 ||
+        file.version != CHIP8_COVER_VERSION ||
+        file.words != CHIP8_COVER_WORDS || file.mode != chip8->mode ||
+        file.rom_hash != chip8->rom_hash) {
+        return CHIP8_ROM_ERR;
+    }
+
+    for (int map = 0; map < CHIP8_COVER_MAX; map++) {
+        off_t offset = sizeof(file) + map * sizeof(words);
+
+        if (pread(fd, words, sizeof(words), offset) != sizeof(words)) {
+            return CHIP8_ROM_ERR;
+        }
+        for (int i = 0; i < CHIP8_COVER_WORDS; i++) {
+            cover->map[map][i] |= words[i];
+        }
+    }
+
+    return CHIP8_OK;
+}
+
+int chip8_cover_load(chip8_cover_t *cover, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    int err;
+
+    if (fd < 0) {
+        return CHIP8_ROM_READ_ERR;
+    }
+
+    err = chip8_cover_merge(cover, fd);
+    close(fd);
+
+    return err;
+}
+
+/**
+ * Rewritten in place under an exclusive flock(), so parallel runs that
+ * finish at the same time each add to the file instead of replacing it.
+ */
+int chip8_cover_save(chip8_cover_t *cover, const char *path)
+{
+    chip8_cover_file_t file;
+    int                fd;
+    int                err;
+    int                ok;
+
+    CHIP8_ASSERT_PTR(cover, CHIP8_INVALID_PTR_ERR);
+    CHIP8_ASSERT_PTR(path, CHIP8_INVALID_PTR_ERR);
+
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return CHIP8_ERR;
+    }
+    if (flock(fd, LOCK_EX) != 0) {
+        close(fd);
+        return CHIP8_ERR;
+    }
+
+    /* an empty file is new, one for another ROM is kept as it is */
+    err = chip8_cover_merge(cover, fd);
+    if (err == CHIP8_ROM_ERR) {
+        close(fd);
+        return err;
+    }
+
+    memset(&file, 0, sizeof(file));
+    memcpy(file.magic, CHIP8_COVER_MAGIC, sizeof(file.magic));
+    file.version  = CHIP8_COVER_VERSION;
+    file.mode     = cover->chip8->mode;
+    file.words    = CHIP8_COVER_WORDS;
+    file.rom_size = cover->chip8->rom_size;
+    file.rom_hash = cover->chip8->rom_hash;
+
+    ok = pwrite(fd, &file, sizeof(file), 0) == sizeof(file) &&
+         pwrite(fd, cover->map, sizeof(cover->map), sizeof(file)) ==
+             sizeof(cover->map);
+    ok &= close(fd) == 0;
+
+    return ok ? CHIP8_OK : CHIP8_ERR;
+}
+
+static const char *chip8_cover_outcome(const chip8_cover_t *cover,
+                                       uint16_t address)
+{
+    static const char *outcomes[] = {
+        "skip never ran",
+        "skip taken only",
+        "skip not taken only",
+        "skip both ways",
+    };
+
+    return outcomes[chip8_cover_test(cover, CHIP8_COVER_TAKEN, address) |
+                    chip8_cover_test(cover, CHIP8_COVER_NOT_TAKEN, address)
+                        << 1];
+}
+
+int chip8_cover_write_listing(const chip8_cover_t *cover, FILE *out)
+{
+    const chip8_t *chip8 = cover->chip8;
+    char           text[CHIP8_DISASM_SIZE];
+    uint32_t       end   = CHIP8_ROM_START + chip8->rom_size;
+    uint32_t       slots = 0;
+    uint32_t       ran   = 0;
+    uint32_t       skips = 0;
+    uint32_t       both  = 0;
+    uint16_t       command;
+    int            hit;
+
+    for (uint32_t address = CHIP8_ROM_START; address < end; address += 2) {
+        command = (CHIP8_MEM(chip8, address) << 8) |
+                  CHIP8_MEM(chip8, address + 1);
+        hit     = chip8_cover_test(cover, CHIP8_COVER_EXECUTED, address);
+
+        slots++;
+        ran += hit;
+
+        fprintf(out, "%c %04X  %04X  %-20s", hit ? '*' : ' ', address,
+                command, chip8_disasm(command, text, sizeof(text)));
+        if (hit && chip8_cover_kind(command) == CHIP8_COVER_SKIP) {
+            skips++;
+            both += chip8_cover_test(cover, CHIP8_COVER_TAKEN, address) &
+                    chip8_cover_test(cover, CHIP8_COVER_NOT_TAKEN, address);
+            fprintf(out, "  ; %s", chip8_cover_outcome(cover, address));
+        }
+        fputc('\n', out);
+    }
+
+    fprintf(out, "# %u of %u slots executed (%.1f%%), %u of %u skips went "
+                 "both ways\n",
+            ran, slots, slots ? 100.0 * ran / slots : 0.0, both, skips);
+
+    return ferror(out) ? CHIP8_ERR : CHIP8_OK;
+}
@@ -0,0 +1,242 @@
+#include <string.h>
+
+#include "chip8_debug.h"
+
+static int chip8_debug_run(chip8_t *chip8, unsigned int cycles,
+                           unsigned int *executed);
+
+int chip8_debug_init(chip8_debug_t *debug, chip8_t *chip8)
+{
+    memset(debug, 0, sizeof(chip8_debug_t));
+    debug->chip8  = chip8;
+    debug->resume = -1;
+
+    return CHIP8_OK;
+}
+
+static void chip8_debug_attach(chip8_debug_t *debug)
+{
+    chip8_t *chip8 = debug->chip8;
+
+    debug->run_handler = chip8->run_handler;
+    debug->run_ctx     = chip8->run_ctx;
+    chip8->run_handler = chip8_debug_run;
+    chip8->run_ctx     = debug;
+    chip8->debug       = debug;
+}
+
+static void chip8_debug_detach(chip8_debug_t *debug)
+{
+    chip8_t *chip8 = debug->chip8;
+
+    if (!chip8 || chip8->debug != debug) {
+        return;
+    }
+
+    chip8->run_handler = debug->run_handler;
+    chip8->run_ctx     = debug->run_ctx;
+    chip8->debug       = NULL;
+}
+
+void chip8_debug_cleanup(chip8_debug_t *debug)
+{
+    chip8_debug_detach(debug);
+    debug->chip8 = NULL;
+}
+
+static void chip8_debug_map(chip8_debug_t *debug, chip8_debug_kind_t kind)
+{
+    uint16_t mask = debug->chip8->memory_mask;
+
+    memset(debug->map[kind], 0, sizeof(debug->map[kind]));
+
+    for (unsigned int i = 0; i < CHIP8_DEBUG_POINTS; i++) {
+        chip8_debug_point_t *point = &debug->points[i];
+
+        if (!point->used || point->kind != kind) {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < point->len; j++) {
+            uint16_t address = (point->address + j) & mask;
+
+            debug->map[kind][address >> 6] |= 1ull << (address & 63);
+        }
+    }
+}
+
+int chip8_debug_add(chip8_debug_t *debug, chip8_debug_kind_t kind,
+                    uint16_t address, uint16_t len,
+                    const chip8_debug_cond_t *cond)
+{
+    chip8_debug_point_t *point = NULL;
+
+    if (kind >= CHIP8_DEBUG_MAX) {
+        return CHIP8_ERR;
+    }
+
+    for (unsigned int i = 0; i < CHIP8_DEBUG_POINTS; i++) {
+        if (!debug->points[i].used) {
+            point = &debug->points[i];
+            break;
+        }
+    }
+    if (!point) {
+        return CHIP8_ALLOC_ERR;
+    }
+
+    memset(point, 0, sizeof(chip8_debug_point_t));
+    point->used     = 1;
+    point->kind     = kind;
+    point->address  = address & debug->chip8->memory_mask;
+    point->len      = kind == CHIP8_DEBUG_WATCH && len ? len : 1;
+    point->cond.reg = CHIP8_DEBUG_ANY;
+    if (cond) {
+        point->cond = *cond;
+    }
+
+    chip8_debug_map(debug, kind);
+
+    if (debug->count++ == 0) {
+        chip8_debug_attach(debug);
+    }
+
+    return CHIP8_OK;
+}
+
+int chip8_debug_remove(chip8_debug_t *debug, chip8_debug_kind_t kind,
+                       uint16_t address)
+{
+    unsigned int removed = 0;
+
+    address &= debug->chip8->memory_mask;
+
+    for (unsigned int i = 0; i < CHIP8_DEBUG_POINTS; i++) {
+        chip8_debug_point_t *point = &debug->points[i];
+
+        if (point->used && point->kind == kind && point->address == address) {
+            point->used = 0;
+            removed++;
+        }
+    }
+    if (!removed) {
+        return CHIP8_ERR;
+    }
+
+    chip8_debug_map(debug, kind);
+
+    debug->count -= removed;
+    if (debug->count == 0) {
+        chip8_debug_detach(debug);
+    }
+
+    return CHIP8_OK;
+}
+
+/**
+ * Slow path once a bitmap bit matched: count one hit on every point that
+ * overlaps the `len` bytes at `address` and whose register condition
+ * holds, however many of its bytes a store covered. Returns the first
+ * overlapping byte of the first point that reached its hit count, or -1.
+ */
+static int32_t chip8_debug_hit(chip8_debug_t *debug, chip8_debug_kind_t kind,
+                               uint16_t address, uint32_t len)
+{
+    chip8_t *chip8 = debug->chip8;
+    uint16_t mask  = chip8->memory_mask;
+    int32_t  stop  = -1;
+
+    for (unsigned int i = 0; i < CHIP8_DEBUG_POINTS; i++) {
+        chip8_debug_point_t *point = &debug->points[i];
+        uint32_t             into  = (address - point->address) & mask;
+
+        if (!point->used || point->kind != kind ||
+            (into >= point->len &&
+             ((point->address - address) & mask) >= len)) {
+            continue;
+        }
+
+        if (point->cond.reg != CHIP8_DEBUG_ANY &&
+            CHIP8_Vx(chip8, point->cond.reg & 0xF) != point->cond.value) {
+            continue;
+        }
+
+        point->hits++;
+        if (point->hits >= point->cond.count && stop < 0) {
+            stop = into < point->len ? address : point->address;
+        }
+    }
+
+    return stop;
+}
+
+void chip8_debug_written(chip8_debug_t *debug, uint16_t address,
+                         uint32_t len)
+{
+    uint16_t mask = debug->chip8->memory_mask;
+    int32_t  stop;
+
+    if (debug->stop.reason != CHIP8_STOP_NONE) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < len; i++) {
+        if (!chip8_debug_test(debug, CHIP8_DEBUG_WATCH, (address + i) & mask)) {
+            continue;
+        }
+
+        stop = chip8_debug_hit(debug, CHIP8_DEBUG_WATCH, address & mask, len);
+        if (stop >= 0) {
+            debug->stop.reason  = CHIP8_STOP_WATCHPOINT;
+            debug->stop.address = stop;
+        }
+        break;
+    }
+}
+
+/**
+ * Interprets one instruction at a time, testing the breakpoint bitmap
+ * before each. A watchpoint lets its store complete and stops after the
+ * instruction. A breakpoint stops before the instruction and is stepped
+ * over on the next run, unless the program counter moved meanwhile.
+ */
+static int chip8_debug_run(chip8_t *chip8, unsigned int cycles,
+                           unsigned int *executed)
+{
+    chip8_debug_t *debug = chip8->run_ctx;
+    unsigned int   count = 0;
+    int            err   = CHIP8_OK;
+    uint16_t       pc;
+
+    debug->stop.reason = CHIP8_STOP_NONE;
+
+    while (count < cycles && err == CHIP8_OK) {
+        pc = chip8->program_counter & chip8->memory_mask;
+
+        if (chip8_debug_test(debug, CHIP8_DEBUG_BREAK, pc) &&
+            pc != debug->resume &&
+            chip8_debug_hit(debug, CHIP8_DEBUG_BREAK, pc, 1) >= 0) {
+            debug->stop.reason  = CHIP8_STOP_BREAKPOINT;
+            debug->stop.address = pc;
+            debug->resume       = pc;
+            err                 = CHIP8_BREAK;
+            break;
+        }
+
+        debug->resume = -1;
+        err           = chip8->cycle_handler(chip8);
+        count++;
+
+        if (err == CHIP8_OK && debug->stop.reason != CHIP8_STOP_NONE) {
+            err = CHIP8_BREAK;
+        }
+    }
+
+    debug->stop.pc = chip8->program_counter;
+
+    if (executed) {
+        *executed = count;
+    }
+
+    return err;
+}
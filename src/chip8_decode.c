@@ -0,0 +1,307 @@
+#include <string.h>
+
+#include "chip8_code.h"
+#include "chip8_decode.h"
+
+extern decode_handler handlers[];
+
+/**
+ * A fused handler runs the group at the program counter. It may retire
+ * fewer instructions than the pattern holds (a skip leaving the group) or
+ * more (a loop iterating in place), but never more than `budget`, and
+ * reports the count through `retired` so chip8_run() stays cycle exact.
+ */
+typedef int (*chip8_fuse_handler)(chip8_t *chip8, const uint16_t *command,
+                                  unsigned int budget, unsigned int *retired);
+
+typedef struct
+{
+    const char        *name;
+    uint8_t            length;
+    uint16_t           mask[CHIP8_FUSE_MAX_LENGTH];
+    uint16_t           match[CHIP8_FUSE_MAX_LENGTH];
+    int                (*check)(const uint16_t *command);
+    chip8_fuse_handler handler;
+} chip8_fuse_pattern_t;
+
+static int chip8_fuse_load_draw(chip8_t *chip8, const uint16_t *command,
+                                unsigned int budget, unsigned int *retired)
+{
+    (void)budget;
+
+    chip8->i_register = command[0] & CHIP8_LSB_MASK(3);
+    chip8->program_counter += 4;
+    *retired = 2;
+
+    return handlers[0xD](chip8, command[1]);
+}
+
+static int chip8_fuse_load_load(chip8_t *chip8, const uint16_t *command,
+                                unsigned int budget, unsigned int *retired)
+{
+    (void)budget;
+
+    CHIP8_Vx(chip8, CHIP8_NIBBLE(command[0], 3)) = command[0] & 0xFF;
+    CHIP8_Vx(chip8, CHIP8_NIBBLE(command[1], 3)) = command[1] & 0xFF;
+    chip8->program_counter += 4;
+    *retired = 2;
+
+    return CHIP8_OK;
+}
+
+static int chip8_fuse_count_loop_check(const uint16_t *command)
+{
+    return CHIP8_NIBBLE(command[0], 3) == CHIP8_NIBBLE(command[1], 3);
+}
+
+/**
+ * 7x01 / 3xkk / 1nnn: increment, leave the loop once Vx = kk, otherwise
+ * jump. When the jump targets the 7x01 itself the loop is run to the end
+ * in one go, or as many whole iterations as the budget allows.
+ */
+static int chip8_fuse_count_loop(chip8_t *chip8, const uint16_t *command,
+                                 unsigned int budget, unsigned int *retired)
+{
+    uint16_t     start  = chip8->program_counter;
+    uint16_t     target = command[2] & CHIP8_LSB_MASK(3);
+    uint8_t      x      = CHIP8_NIBBLE(command[0], 3);
+    uint8_t      kk     = command[1] & 0xFF;
+    unsigned int left, iterations;
+
+    if (target != start) {
+        CHIP8_Vx(chip8, x)++;
+        if (CHIP8_Vx(chip8, x) == kk) {
+            chip8->program_counter = start + 6;
+            *retired               = 2;
+        } else {
+            chip8->program_counter = target;
+            *retired               = 3;
+        }
+        return CHIP8_OK;
+    }
+
+    /* iterations until the increment reaches kk, the last one exits */
+    left = ((kk - CHIP8_Vx(chip8, x) - 1) & 0xFF) + 1;
+
+    if (3 * (left - 1) + 2 <= budget) {
+        CHIP8_Vx(chip8, x)     = kk;
+        chip8->program_counter = start + 6;
+        *retired               = 3 * (left - 1) + 2;
+    } else {
+        iterations = budget / 3;
+        CHIP8_Vx(chip8, x) += iterations;
+        *retired = 3 * iterations;
+    }
+
+    return CHIP8_OK;
+}
+
+static const chip8_fuse_pattern_t chip8_fuse_patterns[CHIP8_FUSE_MAX] = {
+    [CHIP8_FUSE_LOAD_DRAW] = {
+        .name    = "load-draw",
+        .length  = 2,
+        .mask    = { 0xF000, 0xF000 },
+        .match   = { 0xA000, 0xD000 },
+        .handler = chip8_fuse_load_draw,
+    },
+    [CHIP8_FUSE_LOAD_LOAD] = {
+        .name    = "load-load",
+        .length  = 2,
+        .mask    = { 0xF000, 0xF000 },
+        .match   = { 0x6000, 0x6000 },
+        .handler = chip8_fuse_load_load,
+    },
+    [CHIP8_FUSE_COUNT_LOOP] = {
+        .name    = "count-loop",
+        .length  = 3,
+        .mask    = { 0xF0FF, 0xF000, 0xF000 },
+        .match   = { 0x7001, 0x3000, 0x1000 },
+        .check   = chip8_fuse_count_loop_check,
+        .handler = chip8_fuse_count_loop,
+    },
+};
+
+const char *chip8_fuse_name(chip8_fuse_t fuse)
+{
+    if (fuse <= CHIP8_FUSE_NONE || fuse >= CHIP8_FUSE_MAX) {
+        return NULL;
+    }
+
+    return chip8_fuse_patterns[fuse].name;
+}
+
+int chip8_fuse_parse(const char *patterns, uint32_t *mask)
+{
+    const char *name = patterns;
+    size_t      len;
+    int         fuse;
+
+    CHIP8_ASSERT_PTR(mask, CHIP8_INVALID_PTR_ERR);
+
+    *mask = 0;
+    if (!patterns || strcmp(patterns, "all") == 0) {
+        *mask = CHIP8_FUSE_ALL;
+        return CHIP8_OK;
+    }
+    if (strcmp(patterns, "none") == 0) {
+        return CHIP8_OK;
+    }
+
+    while (*name) {
+        len = strcspn(name, ",");
+
+        for (fuse = CHIP8_FUSE_NONE + 1; fuse < CHIP8_FUSE_MAX; fuse++) {
+            if (strlen(chip8_fuse_patterns[fuse].name) == len &&
+                strncmp(chip8_fuse_patterns[fuse].name, name, len) == 0) {
+                break;
+            }
+        }
+        if (fuse == CHIP8_FUSE_MAX) {
+            return CHIP8_ERR;
+        }
+
+        *mask |= 1u << fuse;
+        name += len + (name[len] == ',');
+    }
+
+    return CHIP8_OK;
+}
+
+static void chip8_decoder_decode(chip8_decoder_t *decoder, uint16_t address)
+{
+    chip8_t         *chip8 = decoder->chip8;
+    chip8_decoded_t *entry = &decoder->entries[address];
+    uint16_t         command[CHIP8_FUSE_MAX_LENGTH];
+    unsigned int     length = 1;
+    int              fuse, i;
+
+    for (i = 0; i < CHIP8_FUSE_MAX_LENGTH; i++) {
+        command[i] = (CHIP8_MEM(chip8, address + 2 * i) << 8) |
+                     CHIP8_MEM(chip8, address + 2 * i + 1);
+    }
+
+    entry->fuse = CHIP8_FUSE_NONE;
+
+    for (fuse = CHIP8_FUSE_NONE + 1; fuse < CHIP8_FUSE_MAX; fuse++) {
+        const chip8_fuse_pattern_t *pattern = &chip8_fuse_patterns[fuse];
+
+        if (!(decoder->fuse_mask & (1u << fuse)) ||
+            address + 2 * pattern->length > chip8->memory_mask + 1) {
+            continue;
+        }
+
+        for (i = 0; i < pattern->length; i++) {
+            if ((command[i] & pattern->mask[i]) != pattern->match[i]) {
+                break;
+            }
+        }
+
+        if (i == pattern->length &&
+            (!pattern->check || pattern->check(command))) {
+            entry->fuse = fuse;
+            length      = pattern->length;
+            break;
+        }
+    }
+
+    memcpy(entry->command, command, sizeof(entry->command));
+    entry->valid = 1;
+
+    chip8_code_mark(chip8, address, 2 * length);
+}
+
+/* a group starts at most 2 * CHIP8_FUSE_MAX_LENGTH - 1 bytes before a write */
+static void chip8_decoder_invalidate(void *ctx, uint16_t address,
+                                     uint32_t len)
+{
+    chip8_decoder_t *decoder = ctx;
+    uint32_t         size    = decoder->chip8->memory_mask + 1;
+    uint32_t         first   = address + size - (2 * CHIP8_FUSE_MAX_LENGTH - 1);
+
+    len += 2 * CHIP8_FUSE_MAX_LENGTH - 1;
+    if (len > size) {
+        len = size;
+    }
+
+    for (uint32_t i = 0; i < len; i++) {
+        decoder->entries[(first + i) & decoder->chip8->memory_mask].valid = 0;
+    }
+}
+
+static int chip8_decoder_run(chip8_t *chip8, unsigned int cycles,
+                             unsigned int *executed)
+{
+    chip8_decoder_t *decoder = chip8->run_ctx;
+    chip8_decoded_t *entry;
+    int              err   = CHIP8_OK;
+    unsigned int     count = 0;
+    unsigned int     retired;
+    uint16_t         address;
+
+    while (count < cycles && err == CHIP8_OK) {
+        address = chip8->program_counter & chip8->memory_mask;
+        entry   = &decoder->entries[address];
+
+        if (!entry->valid) {
+            chip8_decoder_decode(decoder, address);
+        }
+
+        if (entry->fuse != CHIP8_FUSE_NONE &&
+            count + chip8_fuse_patterns[entry->fuse].length <= cycles) {
+            err = chip8_fuse_patterns[entry->fuse].handler(
+                chip8, entry->command, cycles - count, &retired);
+            count += retired;
+            continue;
+        }
+
+        chip8->program_counter += 2;
+        err = handlers[CHIP8_NIBBLE(entry->command[0], 4)](chip8,
+                                                            entry->command[0]);
+        count++;
+    }
+
+    if (executed) {
+        *executed = count;
+    }
+
+    return err;
+}
+
+int chip8_decoder_init(chip8_decoder_t *decoder, chip8_t *chip8,
+                       uint32_t fuse_mask)
+{
+    int err;
+
+    CHIP8_ASSERT_PTR(decoder, CHIP8_INVALID_PTR_ERR);
+    CHIP8_ASSERT_PTR(chip8, CHIP8_INVALID_PTR_ERR);
+
+    memset(decoder->entries, 0, sizeof(decoder->entries));
+    decoder->chip8     = chip8;
+    decoder->fuse_mask = fuse_mask & CHIP8_FUSE_ALL;
+
+    err = chip8_code_watch(chip8, chip8_decoder_invalidate, decoder);
+    if (err != CHIP8_OK) {
+        return err;
+    }
+
+    chip8->run_handler = chip8_decoder_run;
+    chip8->run_ctx     = decoder;
+
+    return CHIP8_OK;
+}
+
+void chip8_decoder_cleanup(chip8_decoder_t *decoder)
+{
+    chip8_t *chip8 = decoder->chip8;
+
+    if (!chip8) {
+        return;
+    }
+
+    chip8_code_unwatch(chip8, chip8_decoder_invalidate, decoder);
+    if (chip8->run_ctx == decoder) {
+        chip8->run_handler = chip8_interpret;
+        chip8->run_ctx     = NULL;
+    }
+    decoder->chip8 = NULL;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+
+#include "chip8_disasm.h"
+
+/**
+ * Operands in the format strings: %x and %y are the register nibbles,
+ * %n the low nibble, %k the low byte and %a the 12 bit address.
+ */
+typedef struct
+{
+    uint16_t    mask;
+    uint16_t    match;
+    const char *format;
+} chip8_disasm_t;
+
+static const chip8_disasm_t chip8_disasm_table[] = {
+    { 0xFFFF, 0x00E0, "CLS" },
+    { 0xFFFF, 0x00EE, "RET" },
+    { 0xFFF0, 0x00C0, "SCD %n" },
+    { 0xFFF0, 0x00D0, "SCU %n" },
+    { 0xFFFF, 0x00FB, "SCR" },
+    { 0xFFFF, 0x00FC, "SCL" },
+    { 0xFFFF, 0x00FD, "EXIT" },
+    { 0xFFFF, 0x00FE, "LOW" },
+    { 0xFFFF, 0x00FF, "HIGH" },
+    { 0xF000, 0x0000, "SYS %a" },
+    { 0xF000, 0x1000, "JP %a" },
+    { 0xF000, 0x2000, "CALL %a" },
+    { 0xF000, 0x3000, "SE V%x, %k" },
+    { 0xF000, 0x4000, "SNE V%x, %k" },
+    { 0xF00F, 0x5000, "SE V%x, V%y" },
+    { 0xF00F, 0x5002, "SAVE V%x-V%y" },
+    { 0xF00F, 0x5003, "LOAD V%x-V%y" },
+    { 0xF000, 0x6000, "LD V%x, %k" },
+    { 0xF000, 0x7000, "ADD V%x, %k" },
+    { 0xF00F, 0x8000, "LD V%x, V%y" },
+    { 0xF00F, 0x8001, "OR V%x, V%y" },
+    { 0xF00F, 0x8002, "AND V%x, V%y" },
+    { 0xF00F, 0x8003, "XOR V%x, V%y" },
+    { 0xF00F, 0x8004, "ADD V%x, V%y" },
+    { 0xF00F, 0x8005, "SUB V%x, V%y" },
+    { 0xF00F, 0x8006, "SHR V%x, V%y" },
+    { 0xF00F, 0x8007, "SUBN V%x, V%y" },
+    { 0xF00F, 0x800E, "SHL V%x, V%y" },
+    { 0xF00F, 0x9000, "SNE V%x, V%y" },
+    { 0xF000, 0xA000, "LD I, %a" },
+    { 0xF000, 0xB000, "JP V0, %a" },
+    { 0xF000, 0xC000, "RND V%x, %k" },
+    { 0xF000, 0xD000, "DRW V%x, V%y, %n" },
+    { 0xF0FF, 0xE09E, "SKP V%x" },
+    { 0xF0FF, 0xE0A1, "SKNP V%x" },
+    { 0xFFFF, 0xF000, "LD I, long" },
+    { 0xFFFF, 0xF002, "AUDIO" },
+    { 0xF0FF, 0xF001, "PLANE %x" },
+    { 0xF0FF, 0xF007, "LD V%x, DT" },
+    { 0xF0FF, 0xF00A, "LD V%x, K" },
+    { 0xF0FF, 0xF015, "LD DT, V%x" },
+    { 0xF0FF, 0xF018, "LD ST, V%x" },
+    { 0xF0FF, 0xF01E, "ADD I, V%x" },
+    { 0xF0FF, 0xF029, "LD F, V%x" },
+    { 0xF0FF, 0xF030, "LD HF, V%x" },
+    { 0xF0FF, 0xF033, "LD B, V%x" },
+    { 0xF0FF, 0xF03A, "PITCH V%x" },
+    { 0xF0FF, 0xF055, "LD [I], V%x" },
+    { 0xF0FF, 0xF065, "LD V%x, [I]" },
+    { 0xF0FF, 0xF075, "LD R, V%x" },
+    { 0xF0FF, 0xF085, "LD V%x, R" },
+};
+
+#define CHIP8_DISASM_COUNT                                                     \
+    (sizeof(chip8_disasm_table) / sizeof(chip8_disasm_table[0]))
+
+const char *chip8_disasm(uint16_t command, char *buf, size_t size)
+{
+    const char *format = NULL;
+    size_t      used   = 0;
+    int         n;
+
+    for (size_t i = 0; i < CHIP8_DISASM_COUNT; i++) {
+        if ((command & chip8_disasm_table[i].mask) ==
+            chip8_disasm_table[i].match) {
+            format = chip8_disasm_table[i].format;
+            break;
+        }
+    }
+
+    if (!format) {
+        snprintf(buf, size, "DW 0x%04X", command);
+        return buf;
+    }
+
+    for (; *format && used + 1 < size; format++) {
+        if (*format != '%') {
+            buf[used++] = *format;
+            continue;
+        }
+
+        switch (*++format) {
+        case 'x':
+            n = snprintf(buf + used, size - used, "%X",
+                         CHIP8_NIBBLE(command, 3));
+            break;
+        case 'y':
+            n = snprintf(buf + used, size - used, "%X",
+                         CHIP8_NIBBLE(command, 2));
+            break;
+        case 'n':
+            n = snprintf(buf + used, size - used, "%X",
+                         CHIP8_NIBBLE(command, 1));
+            break;
+        case 'k':
+            n = snprintf(buf + used, size - used, "0x%02X", command & 0xFF);
+            break;
+        default:
+            n = snprintf(buf + used, size - used, "0x%03X",
+                         command & CHIP8_LSB_MASK(3));
+            break;
+        }
+
+        used += n < 0 ? 0 : (size_t)n;
+        if (used >= size) {
+            used = size - 1;
+        }
+    }
+    buf[used] = '\0';
+
+    return buf;
+}
@@ -0,0 +1,161 @@
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "chip8_display.h"
+
+#define CHIP8_DISPLAY_SCROLL_X (4)
+
+typedef unsigned __int128 chip8_wide_row_t;
+
+static inline chip8_wide_row_t chip8_row_load(const chip8_row_t row)
+{
+    return ((chip8_wide_row_t)row[0] << 64) | row[1];
+}
+
+static inline void chip8_row_store(chip8_row_t row, chip8_wide_row_t value)
+{
+    row[0] = (uint64_t)(value >> 64);
+    row[1] = (uint64_t)value;
+}
+
+/* 0babcdefgh -> 0baabbccddeeffgghh, used to draw lo-res sprites */
+static inline uint32_t chip8_double_bits(uint32_t bits)
+{
+    bits = (bits | (bits << 8)) & 0x00FF00FF;
+    bits = (bits | (bits << 4)) & 0x0F0F0F0F;
+    bits = (bits | (bits << 2)) & 0x33333333;
+    bits = (bits | (bits << 1)) & 0x55555555;
+
+    return bits | (bits << 1);
+}
+
+void chip8_display_clear(chip8_row_t *rows)
+{
+    memset(rows, 0, sizeof(chip8_row_t) * CHIP8_DISPLAY_HEIGHT);
+}
+
+uint8_t chip8_display_draw(chip8_row_t *rows, const uint8_t *sprite,
+                           unsigned int height, uint8_t wide, unsigned int x,
+                           unsigned int y, uint8_t hires)
+{
+    unsigned int     scale = hires ? 1 : 2;
+    unsigned int     width = (wide ? 16 : 8) * scale;
+    unsigned int     shift;
+    uint8_t          collision = 0;
+    chip8_wide_row_t mask, row;
+
+    /* physical coordinates, the modulo gives the wrap-around */
+    x = (x * scale) % CHIP8_DISPLAY_WIDTH;
+    y = (y * scale) % CHIP8_DISPLAY_HEIGHT;
+
+    for (unsigned int line = 0; line < height; line++) {
+        uint32_t bits = wide ? (sprite[2 * line] << 8) | sprite[2 * line + 1]
+                             : sprite[line];
+
+        if (!bits) {
+            continue;
+        }
+
+        if (!hires) {
+            bits = chip8_double_bits(bits);
+        }
+
+        /* left-align the sprite row, then rotate it into place */
+        mask  = (chip8_wide_row_t)bits << (CHIP8_DISPLAY_WIDTH - width);
+        shift = x;
+        if (shift) {
+            mask = (mask >> shift) | (mask << (CHIP8_DISPLAY_WIDTH - shift));
+        }
+
+        for (unsigned int i = 0; i < scale; i++) {
+            uint64_t *dst = rows[(y + line * scale + i) % CHIP8_DISPLAY_HEIGHT];
+
+            row = chip8_row_load(dst);
+            collision |= (row & mask) != 0;
+            chip8_row_store(dst, row ^ mask);
+        }
+    }
+
+    return collision;
+}
+
+void chip8_display_scroll_down(chip8_row_t *rows, unsigned int n,
+                               uint8_t hires)
+{
+    n *= hires ? 1 : 2;
+    if (n >= CHIP8_DISPLAY_HEIGHT) {
+        chip8_display_clear(rows);
+        return;
+    }
+
+    memmove(rows[n], rows[0], sizeof(chip8_row_t) * (CHIP8_DISPLAY_HEIGHT - n));
+    memset(rows[0], 0, sizeof(chip8_row_t) * n);
+}
+
+void chip8_display_scroll_up(chip8_row_t *rows, unsigned int n, uint8_t hires)
+{
+    n *= hires ? 1 : 2;
+    if (n >= CHIP8_DISPLAY_HEIGHT) {
+        chip8_display_clear(rows);
+        return;
+    }
+
+    memmove(rows[0], rows[n], sizeof(chip8_row_t) * (CHIP8_DISPLAY_HEIGHT - n));
+    memset(rows[CHIP8_DISPLAY_HEIGHT - n], 0, sizeof(chip8_row_t) * n);
+}
+
+/**
+ * Horizontal scrolls shift every row as one 128-bit value. With SSE2 a row
+ * is one register: both 64-bit lanes are shifted and the bits crossing the
+ * lane boundary are moved over with a byte shift, three ops per row.
+ */
+void chip8_display_scroll_left(chip8_row_t *rows, uint8_t hires)
+{
+    unsigned int n = CHIP8_DISPLAY_SCROLL_X * (hires ? 1 : 2);
+
+#if defined(__SSE2__)
+    __m128i count = _mm_cvtsi32_si128(n);
+    __m128i carry = _mm_cvtsi32_si128(64 - n);
+
+    for (unsigned int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+        __m128i row = _mm_load_si128((const __m128i *)rows[y]);
+        __m128i out = _mm_sll_epi64(row, count);
+
+        /* word 1 holds the right half, its top bits move into word 0 */
+        out = _mm_or_si128(out,
+                           _mm_srli_si128(_mm_srl_epi64(row, carry), 8));
+        _mm_store_si128((__m128i *)rows[y], out);
+    }
+#else
+    for (unsigned int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+        chip8_row_store(rows[y], chip8_row_load(rows[y]) << n);
+    }
+#endif
+}
+
+void chip8_display_scroll_right(chip8_row_t *rows, uint8_t hires)
+{
+    unsigned int n = CHIP8_DISPLAY_SCROLL_X * (hires ? 1 : 2);
+
+#if defined(__SSE2__)
+    __m128i count = _mm_cvtsi32_si128(n);
+    __m128i carry = _mm_cvtsi32_si128(64 - n);
+
+    for (unsigned int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+        __m128i row = _mm_load_si128((const __m128i *)rows[y]);
+        __m128i out = _mm_srl_epi64(row, count);
+
+        /* the low bits of word 0 move into the top of word 1 */
+        out = _mm_or_si128(out,
+                           _mm_slli_si128(_mm_sll_epi64(row, carry), 8));
+        _mm_store_si128((__m128i *)rows[y], out);
+    }
+#else
+    for (unsigned int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+        chip8_row_store(rows[y], chip8_row_load(rows[y]) >> n);
+    }
+#endif
+}
@@ -1,7 +1,76 @@
 #include <string.h>
-#include <stdlib.h>
 
 #include "chip8.h"
+#include "chip8_code.h"
+#include "chip8_debug.h"
+#include "chip8_display.h"
+#include "chip8_profile.h"
+
+/**
+ * Skip the next instruction. XO-CHIP's F000 nnnn is four bytes long and is
+ * skipped as a whole; the classic modes reject F000, so a skip over it is
+ * an ordinary 2 byte skip there.
+ */
+static inline void chip8_skip(chip8_t *chip8)
+{
+    uint16_t next = (CHIP8_MEM(chip8, chip8->program_counter) << 8) |
+                    CHIP8_MEM(chip8, chip8->program_counter + 1);
+
+    chip8->program_counter +=
+        chip8->mode == CHIP8_MODE_XOCHIP && next == CHIP8_LONG_LOAD ? 4 : 2;
+}
+
+/* Fx33: hundreds, tens and ones of every byte value, built at compile time */
+#define CHIP8_BCD(n) { (n) / 100, (n) / 10 % 10, (n) % 10 }
+#define CHIP8_BCD_4(n)                                                         \
+    CHIP8_BCD(n), CHIP8_BCD((n) + 1), CHIP8_BCD((n) + 2), CHIP8_BCD((n) + 3)
+#define CHIP8_BCD_16(n)                                                        \
+    CHIP8_BCD_4(n), CHIP8_BCD_4((n) + 4), CHIP8_BCD_4((n) + 8),                \
+        CHIP8_BCD_4((n) + 12)
+#define CHIP8_BCD_64(n)                                                        \
+    CHIP8_BCD_16(n), CHIP8_BCD_16((n) + 16), CHIP8_BCD_16((n) + 32),           \
+        CHIP8_BCD_16((n) + 48)
+
+static const uint8_t chip8_bcd[256][3] = {
+    CHIP8_BCD_64(0),
+    CHIP8_BCD_64(64),
+    CHIP8_BCD_64(128),
+    CHIP8_BCD_64(192),
+};
+
+/**
+ * Copy `len` bytes between the registers and memory at I. Only a block
+ * that wraps past the top of the address space takes the per-byte path.
+ */
+static inline void chip8_store(chip8_t *chip8, const uint8_t *src, int len)
+{
+    if (chip8->i_register + len <= chip8->memory_mask + 1) {
+        memcpy(&chip8->memory[chip8->i_register], src, len);
+    } else {
+        for (int i = 0; i < len; i++) {
+            CHIP8_MEM(chip8, chip8->i_register + i) = src[i];
+        }
+    }
+
+    chip8_code_written(chip8, chip8->i_register, len);
+    CHIP8_DEBUG_WRITTEN(chip8, chip8->i_register, len);
+}
+
+static inline void chip8_load(chip8_t *chip8, uint8_t *dst, int len)
+{
+    if (chip8->i_register + len <= chip8->memory_mask + 1) {
+        memcpy(dst, &chip8->memory[chip8->i_register], len);
+        return;
+    }
+
+    for (int i = 0; i < len; i++) {
+        dst[i] = CHIP8_MEM(chip8, chip8->i_register + i);
+    }
+}
+
+#define CHIP8_FOR_EACH_PLANE(chip8, plane)                                     \
+    for (int plane = 0; plane < CHIP8_PLANES; plane++)                         \
+        if ((chip8)->planes & (1 << plane))
 
 static int chip8_decode_handler_msb_0(chip8_t *chip8, uint16_t command)
 {
@@ -12,7 +81,11 @@ static int chip8_decode_handler_msb_0(chip8_t *chip8, uint16_t command)
      * Clear the display.
      */
     if (command == 0x00E0) {
-        memset(chip8->display, 0, sizeof(chip8->display));
+        CHIP8_FOR_EACH_PLANE(chip8, plane)
+        {
+            chip8_display_clear(chip8->display[plane]);
+        }
+        chip8->draw = 1;
     }
     /**
      * 00EE - RET
@@ -21,10 +94,72 @@ static int chip8_decode_handler_msb_0(chip8_t *chip8, uint16_t command)
      * stack, then subtracts 1 from the stack pointer.
      */
     else if (command == 0x00EE) {
-        CHIP8_ASSERT_SP_VALID(chip8, CHIP8_INVALID_STACK_PTR_ERR);
-
-        chip8->program_counter = chip8->stack[chip8->stack_pointer];
+        chip8->stack_fault |= chip8->stack_pointer - 1u >= CHIP8_STACK_SIZE;
+        chip8->program_counter = CHIP8_STACK_TOP(chip8);
         chip8->stack_pointer--;
+        CHIP8_PROFILE_RETURN(chip8);
+    }
+    /**
+     * 00Cn - SCD nibble (SUPER-CHIP)
+     * Scroll the display down by n pixels.
+     */
+    else if ((command & 0xFFF0) == 0x00C0) {
+        CHIP8_FOR_EACH_PLANE(chip8, plane)
+        {
+            chip8_display_scroll_down(chip8->display[plane],
+                                      CHIP8_NIBBLE(command, 1), chip8->hires);
+        }
+        chip8->draw = 1;
+    }
+    /**
+     * 00Dn - SCU nibble (XO-CHIP)
+     * Scroll the selected planes up by n pixels.
+     */
+    else if ((command & 0xFFF0) == 0x00D0) {
+        CHIP8_ASSERT_MODE(chip8, CHIP8_MODE_XOCHIP, CHIP8_OPCODE_ERR);
+
+        CHIP8_FOR_EACH_PLANE(chip8, plane)
+        {
+            chip8_display_scroll_up(chip8->display[plane],
+                                    CHIP8_NIBBLE(command, 1), chip8->hires);
+        }
+        chip8->draw = 1;
+    }
+    /**
+     * 00FB - SCR (SUPER-CHIP)
+     * Scroll the display right by 4 pixels.
+     */
+    else if (command == 0x00FB) {
+        CHIP8_FOR_EACH_PLANE(chip8, plane)
+        {
+            chip8_display_scroll_right(chip8->display[plane], chip8->hires);
+        }
+        chip8->draw = 1;
+    }
+    /**
+     * 00FC - SCL (SUPER-CHIP)
+     * Scroll the display left by 4 pixels.
+     */
+    else if (command == 0x00FC) {
+        CHIP8_FOR_EACH_PLANE(chip8, plane)
+        {
+            chip8_display_scroll_left(chip8->display[plane], chip8->hires);
+        }
+        chip8->draw = 1;
+    }
+    /**
+     * 00FE - LOW (SUPER-CHIP)
+     * Disable extended screen mode, back to 64x32.
+     */
+    else if (command == 0x00FE) {
+        chip8->hires = 0;
+    }
+    /**
+     * 00FF - HIGH (SUPER-CHIP)
+     * Enable extended screen mode for full-screen graphics, 128x64.
+     */
+    else if (command == 0x00FF) {
+        chip8->hires = 1;
     }
 
     return CHIP8_OK;
@@ -57,10 +192,10 @@ static int chip8_decode_handler_msb_2(chip8_t *chip8, uint16_t command)
      * The PC is then set to nnn.
      */
     chip8->stack_pointer++;
-    CHIP8_ASSERT_SP_VALID(chip8, CHIP8_INVALID_STACK_PTR_ERR);
-
+    chip8->stack_fault |= chip8->stack_pointer > CHIP8_STACK_SIZE;
     CHIP8_STACK_TOP(chip8) = chip8->program_counter;
     chip8->program_counter = command & CHIP8_LSB_MASK(3);
+    CHIP8_PROFILE_CALL(chip8, chip8->program_counter);
 
     return CHIP8_OK;
 }
@@ -84,7 +219,7 @@ static int chip8_decode_handler_msb_3(chip8_t *chip8, uint16_t command)
     CHIP8_ASSERT_VALID_REGISTER(chip8, x, CHIP8_INVALID_REGISTER_ERR);
 
     if (CHIP8_Vx(chip8, x) == kk) {
-        chip8->program_counter += 2;
+        chip8_skip(chip8);
     }
 
     return CHIP8_OK;
@@ -109,7 +244,7 @@ static int chip8_decode_handler_msb_4(chip8_t *chip8, uint16_t command)
     CHIP8_ASSERT_VALID_REGISTER(chip8, x, CHIP8_INVALID_REGISTER_ERR);
 
     if (CHIP8_Vx(chip8, x) != kk) {
-        chip8->program_counter += 2;
+        chip8_skip(chip8);
     }
 
     return CHIP8_OK;
@@ -118,8 +253,18 @@ static int chip8_decode_handler_msb_4(chip8_t *chip8, uint16_t command)
 static int chip8_decode_handler_msb_5(chip8_t *chip8, uint16_t command)
 {
     uint8_t x, y;
+    int     step;
     CHIP8_ASSERT_PTR(chip8, CHIP8_INVALID_PTR_ERR);
 
+    y = CHIP8_NIBBLE(command, 2);
+    x = CHIP8_NIBBLE(command, 3);
+
+    CHIP8_ASSERT_VALID_REGISTER(chip8, x, CHIP8_INVALID_REGISTER_ERR);
+    CHIP8_ASSERT_VALID_REGISTER(chip8, y, CHIP8_INVALID_REGISTER_ERR);
+
+    step = x <= y ? 1 : -1;
+
+    switch (CHIP8_NIBBLE(command, 1)) {
     /**
      * 5xy0 - SE Vx, Vy
      * Skip next instruction if Vx = Vy.
@@ -127,15 +272,52 @@ static int chip8_decode_handler_msb_5(chip8_t *chip8, uint16_t command)
      * The interpreter compares register Vx to register Vy,
      * and if they are equal, increments the program counter by 2.
      */
+    case 0x0:
+        if (CHIP8_Vx(chip8, x) == CHIP8_Vx(chip8, y)) {
+            chip8_skip(chip8);
+        }
+        break;
 
-    y = CHIP8_NIBBLE(command, 2);
-    x = CHIP8_NIBBLE(command, 3);
+    /**
+     * 5xy2 - SAVE Vx - Vy (XO-CHIP)
+     * Store registers Vx through Vy in memory starting at location I.
 
-    CHIP8_ASSERT_VALID_REGISTER(chip8, x, CHIP8_INVALID_REGISTER_ERR);
-    CHIP8_ASSERT_VALID_REGISTER(chip8, y, CHIP8_INVALID_REGISTER_ERR);
+     * Works in either direction (x may be greater than y), I is not
+     modified.
+     */
+    case 0x2:
+        CHIP8_ASSERT_MODE(chip8, CHIP8_MODE_XOCHIP, CHIP8_OPCODE_ERR);
+
+        for (int i = 0, r = x;; i++, r += step) {
+            CHIP8_MEM(chip8, chip8->i_register + i) = CHIP8_Vx(chip8, r);
+            if (r == y) {
+                chip8_code_written(chip8, chip8->i_register, i + 1);
+                CHIP8_DEBUG_WRITTEN(chip8, chip8->i_register, i + 1);
+                break;
+            }
+        }
+        break;
 
-    if (CHIP8_Vx(chip8, x) != CHIP8_Vx(chip8, y)) {
-        chip8->program_counter += 2;
+    /**
+     * 5xy3 - LOAD Vx - Vy (XO-CHIP)
+     * Read registers Vx through Vy from memory starting at location I.
+
+     * Works in either direction (x may be greater than y), I is not
+     modified.
+     */
+    case 0x3:
+        CHIP8_ASSERT_MODE(chip8, CHIP8_MODE_XOCHIP, CHIP8_OPCODE_ERR);
+
+        for (int i = 0, r = x;; i++, r += step) {
+            CHIP8_Vx(chip8, r) = CHIP8_MEM(chip8, chip8->i_register + i);
+            if (r == y) {
+                break;
+            }
+        }
+        break;
+
+    default:
+        return CHIP8_OPCODE_ERR;
     }
 
     return CHIP8_OK;
@@ -352,7 +534,7 @@ static int chip8_decode_handler_msb_9(chip8_t *chip8, uint16_t command)
     CHIP8_ASSERT_VALID_REGISTER(chip8, y, CHIP8_INVALID_REGISTER_ERR);
 
     if (CHIP8_Vx(chip8, x) != CHIP8_Vx(chip8, y)) {
-        chip8->program_counter += 2;
+        chip8_skip(chip8);
     }
 
     return CHIP8_OK;
@@ -407,14 +589,25 @@ static int chip8_decode_handler_msb_C(chip8_t *chip8, uint16_t command)
 
     CHIP8_ASSERT_VALID_REGISTER(chip8, x, CHIP8_INVALID_REGISTER_ERR);
 
-    CHIP8_Vx(chip8, x) = (rand() % 256) & kk;
+    /**
+     * xorshift32 kept in chip8_t rather than rand(), so the sequence is part
+     * of the saved state and replays identically after chip8_load_state().
+     */
+    chip8->rng ^= chip8->rng << 13;
+    chip8->rng ^= chip8->rng >> 17;
+    chip8->rng ^= chip8->rng << 5;
+
+    CHIP8_Vx(chip8, x) = (chip8->rng >> 24) & kk;
 
     return CHIP8_OK;
 }
 
 static int chip8_decode_handler_msb_D(chip8_t *chip8, uint16_t command)
 {
-    uint8_t x, y, n, x_pos, y_pos, pixel;
+    uint8_t  x, y, n, wide, bytes;
+    uint8_t  sprite[32];
+    uint8_t  collision = 0;
+    uint16_t address;
 
     CHIP8_ASSERT_PTR(chip8, CHIP8_INVALID_PTR_ERR);
 
@@ -436,6 +629,12 @@ static int chip8_decode_handler_msb_D(chip8_t *chip8, uint16_t command)
      * See instruction 8xy3 for more information on XOR,
      * and section 2.4, Display, for more information on the Chip-8 screen and
      sprites.
+
+     * Dxy0 - DRW Vx, Vy, 0 (SUPER-CHIP)
+     * Display a 16x16 sprite (32 bytes, two per row) at (Vx, Vy).
+
+     * XO-CHIP: the sprite is drawn to every plane selected by Fn01, each
+     plane taking the next sprite-sized chunk of memory after I.
      */
 
     x = CHIP8_NIBBLE(command, 3);
@@ -445,28 +644,24 @@ static int chip8_decode_handler_msb_D(chip8_t *chip8, uint16_t command)
     CHIP8_ASSERT_VALID_REGISTER(chip8, x, CHIP8_INVALID_REGISTER_ERR);
     CHIP8_ASSERT_VALID_REGISTER(chip8, y, CHIP8_INVALID_REGISTER_ERR);
 
-    x_pos = CHIP8_Vx(chip8, x);
-    y_pos = CHIP8_Vx(chip8, y);
-
-    CHIP8_VF(chip8) = 0;
-
-    for (int y_line = 0; y_line < n; y_line++) {
-        pixel = chip8->memory[chip8->i_register + y_line];
-        for (int x_line = 0; x_line < 8; x_line++) {
-            if ((pixel & (0x80 >> x_line)) != 0) {
-                uint8_t screen_x = (x_pos + x_line) % CHIP8_DISPLAY_WIDTH;
-                uint8_t screen_y = (y_pos + y_line) % CHIP8_DISPLAY_HEIGHT;
+    wide    = n == 0;
+    bytes   = wide ? 32 : n;
+    address = chip8->i_register;
 
-                if (chip8->display[screen_y][screen_x] == 1) {
-                    CHIP8_VF(chip8) = 1;
-                }
-                chip8->display[screen_y][screen_x] ^= 1;
-            }
+    CHIP8_FOR_EACH_PLANE(chip8, plane)
+    {
+        for (int i = 0; i < bytes; i++) {
+            sprite[i] = CHIP8_MEM(chip8, address + i);
         }
+        address += bytes;
+
+        collision |= chip8_display_draw(
+            chip8->display[plane], sprite, wide ? 16 : n, wide,
+            CHIP8_Vx(chip8, x), CHIP8_Vx(chip8, y), chip8->hires);
     }
 
-    chip8->draw = 1;
-    chip8->program_counter += 2;
+    CHIP8_VF(chip8) = collision;
+    chip8->draw     = 1;
 
     return CHIP8_OK;
 }
@@ -492,19 +687,24 @@ static int chip8_decode_handler_msb_E(chip8_t *chip8, uint16_t command)
      * PC is increased by 2.
      */
     if ((command & CHIP8_LSB_MASK(2)) == 0x009E) {
-        if (chip8->keypad_state[CHIP8_Vx(chip8, x)] == CHIP8_KEY_PRESSED) {
-            chip8->program_counter += 2;
+        chip8->key_reads++;
+        if ((chip8_keypad(chip8) >> CHIP8_Vx(chip8, x)) & 1) {
+            chip8_skip(chip8);
         }
     }
     /**
      * ExA1 - SKNP Vx
      * Skip next instruction if key with the value of Vx is not pressed.
 
-     * Checks the
+     * Checks the keyboard,
+     * and if the key corresponding to the value of Vx is currently in the up
+     position,
+     * PC is increased by 2.
      */
     else if ((command & CHIP8_LSB_MASK(2)) == 0x00A1) {
-        if (chip8->keypad_state[CHIP8_Vx(chip8, x)] != CHIP8_KEY_IDLE) {
-            chip8->program_counter += 2;
+        chip8->key_reads++;
+        if (!((chip8_keypad(chip8) >> CHIP8_Vx(chip8, x)) & 1)) {
+            chip8_skip(chip8);
         }
     }
 
@@ -513,70 +713,224 @@ static int chip8_decode_handler_msb_E(chip8_t *chip8, uint16_t command)
 
 static int chip8_decode_handler_msb_F(chip8_t *chip8, uint16_t command)
 {
+    uint8_t  x;
+    uint16_t keys, pressed;
+
     CHIP8_ASSERT_PTR(chip8, CHIP8_INVALID_PTR_ERR);
-    (void)command;
 
+    x = CHIP8_NIBBLE(command, 3);
+
+    CHIP8_ASSERT_VALID_REGISTER(chip8, x, CHIP8_INVALID_REGISTER_ERR);
+
+    switch (command & CHIP8_LSB_MASK(2)) {
     /**
-     * Fx07 - LD Vx, DT
-     * Set Vx = delay timer value.
+     * F000 nnnn - LD I, long addr (XO-CHIP)
+     * Set I = nnnn, the 16 bit address following the instruction.
 
-     * The value of DT is placed into Vx.
+     * The instruction is 4 bytes long; skips step over it as a whole.
+     */
+    case 0x00:
+        CHIP8_ASSERT_MODE(chip8, CHIP8_MODE_XOCHIP, CHIP8_OPCODE_ERR);
+        if (x != 0) {
+            return CHIP8_OPCODE_ERR;
+        }
+
+        chip8->i_register = (CHIP8_MEM(chip8, chip8->program_counter) << 8) |
+                            CHIP8_MEM(chip8, chip8->program_counter + 1);
+        chip8->program_counter += 2;
+        break;
+
+    /**
+     * Fn01 - PLANE n (XO-CHIP)
+     * Select the bitplanes (bit mask n) that drawing, clearing and
+     scrolling apply to.
+     */
+    case 0x01:
+        CHIP8_ASSERT_MODE(chip8, CHIP8_MODE_XOCHIP, CHIP8_OPCODE_ERR);
+
+        chip8->planes = x;
+        break;
+
+    /**
+     * F002 - AUDIO (XO-CHIP)
+     * Load the 16 byte audio pattern buffer from memory starting at I.
+     */
+    case 0x02:
+        CHIP8_ASSERT_MODE(chip8, CHIP8_MODE_XOCHIP, CHIP8_OPCODE_ERR);
+        if (x != 0) {
+            return CHIP8_OPCODE_ERR;
+        }
 
+        for (int i = 0; i < CHIP8_AUDIO_BYTES; i++) {
+            chip8->audio_pattern[i] = CHIP8_MEM(chip8, chip8->i_register + i);
+        }
+        break;
 
+    /**
+     * Fx3A - PITCH Vx (XO-CHIP)
+     * Set the audio pattern playback rate to 4000*2^((Vx-64)/48) Hz.
+     */
+    case 0x3A:
+        CHIP8_ASSERT_MODE(chip8, CHIP8_MODE_XOCHIP, CHIP8_OPCODE_ERR);
+
+        chip8->pitch = CHIP8_Vx(chip8, x);
+        break;
+
+    /**
      * Fx0A - LD Vx, K
      * Wait for a key press, store the value of the key in Vx.
 
      * All execution stops until a key is pressed, then the value of that key is
      stored in Vx.
+     * Keys already held when the wait started do not count until released.
+     * While waiting the PC is rewound onto this instruction and
+     CHIP8_KEY_WAIT is returned, so the caller can park on
+     chip8_keypad_wait() instead of spinning.
+     */
+    case 0x0A:
+        chip8->key_reads++;
+        keys = chip8_keypad(chip8);
+        if (!chip8->key_waiting) {
+            chip8->key_waiting   = 1;
+            chip8->key_wait_mask = keys;
+        }
+
+        pressed = keys & ~chip8->key_wait_mask;
+        chip8->key_wait_mask &= keys;
+
+        if (!pressed) {
+            chip8->program_counter -= 2;
+            return CHIP8_KEY_WAIT;
+        }
+
+        chip8->key_waiting = 0;
+        CHIP8_Vx(chip8, x) = __builtin_ctz(pressed);
+        break;
+
+    /**
+     * Fx07 - LD Vx, DT
+     * Set Vx = delay timer value.
 
+     * The value of DT is placed into Vx.
+     */
+    case 0x07:
+        CHIP8_Vx(chip8, x) = chip8->delay_timer;
+        break;
 
+    /**
      * Fx15 - LD DT, Vx
      * Set delay timer = Vx.
 
      * DT is set equal to the value of Vx.
+     */
+    case 0x15:
+        chip8->delay_timer = CHIP8_Vx(chip8, x);
+        break;
 
-
+    /**
      * Fx18 - LD ST, Vx
      * Set sound timer = Vx.
 
      * ST is set equal to the value of Vx.
+     */
+    case 0x18:
+        chip8->sound_timer = CHIP8_Vx(chip8, x);
+        break;
 
-
+    /**
      * Fx1E - ADD I, Vx
      * Set I = I + Vx.
 
      * The values of I and Vx are added, and the results are stored in I.
+     */
+    case 0x1E:
+        chip8->i_register += CHIP8_Vx(chip8, x);
+        break;
 
-
+    /**
      * Fx29 - LD F, Vx
      * Set I = location of sprite for digit Vx.
 
      * The value of I is set to the location for the hexadecimal sprite
      corresponding to the value of Vx. See section 2.4, Display, for more
      information on the Chip-8 hexadecimal font.
+     */
+    case 0x29:
+        chip8->i_register =
+            CHIP8_FONT_START + (CHIP8_Vx(chip8, x) & 0xF) * CHIP8_FONT_SIZE;
+        break;
 
+    /**
+     * Fx30 - LD HF, Vx (SUPER-CHIP)
+     * Set I = location of the 8x10 sprite for digit Vx.
+     */
+    case 0x30:
+        chip8->i_register = CHIP8_BIG_FONT_START +
+                            (CHIP8_Vx(chip8, x) & 0xF) * CHIP8_BIG_FONT_SIZE;
+        break;
 
+    /**
      * Fx33 - LD B, Vx
      * Store BCD representation of Vx in memory locations I, I+1, and I+2.
 
      * The interpreter takes the decimal value of Vx, and places the hundreds
      digit in memory at location in I, the tens digit at location I+1, and the
      ones digit at location I+2.
+     */
+    case 0x33:
+        chip8_store(chip8, chip8_bcd[CHIP8_Vx(chip8, x)], 3);
+        break;
 
-
+    /**
      * Fx55 - LD [I], Vx
      * Store registers V0 through Vx in memory starting at location I.
 
      * The interpreter copies the values of registers V0 through Vx into memory,
      starting at the address in I.
+     * Like the COSMAC VIP and XO-CHIP, I is left pointing past the last byte
+     written; SUPER-CHIP leaves I unchanged.
+     */
+    case 0x55:
+        chip8_store(chip8, chip8->registers, x + 1);
+        if (chip8->mode != CHIP8_MODE_SCHIP) {
+            chip8->i_register += x + 1;
+        }
+        break;
 
-
+    /**
      * Fx65 - LD Vx, [I]
      * Read registers V0 through Vx from memory starting at location I.
 
      * The interpreter reads values from memory starting at location I into
      registers V0 through Vx.
+     * I is advanced the same way as for Fx55.
+     */
+    case 0x65:
+        chip8_load(chip8, chip8->registers, x + 1);
+        if (chip8->mode != CHIP8_MODE_SCHIP) {
+            chip8->i_register += x + 1;
+        }
+        break;
+
+    /**
+     * Fx75 - LD R, Vx (SUPER-CHIP)
+     * Store registers V0 through Vx in the user flags.
      */
+    case 0x75:
+        memcpy(chip8->flags, chip8->registers, x + 1);
+        break;
+
+    /**
+     * Fx85 - LD Vx, R (SUPER-CHIP)
+     * Read registers V0 through Vx from the user flags.
+     */
+    case 0x85:
+        memcpy(chip8->registers, chip8->flags, x + 1);
+        break;
+
+    default:
+        return CHIP8_OPCODE_ERR;
+    }
 
     return CHIP8_OK;
 }
@@ -0,0 +1,305 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "chip8_disasm.h"
+#include "chip8_lockstep.h"
+
+#define CHIP8_LOCKSTEP_PAGE  (1u << CHIP8_DIRTY_PAGE_SHIFT)
+#define CHIP8_LOCKSTEP_SHOWN (8) /* differing elements listed per field */
+
+#define CHIP8_LOCKSTEP_FIELD(field, width)                                     \
+    { #field, offsetof(chip8_t, field), sizeof(((chip8_t *)0)->field), width }
+
+/* the architectural state field by field, for the report */
+static const struct
+{
+    const char *name;
+    size_t      offset;
+    size_t      size;
+    size_t      width; /* of one element */
+} chip8_lockstep_fields[] = {
+    CHIP8_LOCKSTEP_FIELD(draw, 1),
+    CHIP8_LOCKSTEP_FIELD(hires, 1),
+    CHIP8_LOCKSTEP_FIELD(program_counter, 2),
+    CHIP8_LOCKSTEP_FIELD(stack_pointer, 2),
+    CHIP8_LOCKSTEP_FIELD(stack_fault, 1),
+    CHIP8_LOCKSTEP_FIELD(i_register, 2),
+    CHIP8_LOCKSTEP_FIELD(delay_timer, 1),
+    CHIP8_LOCKSTEP_FIELD(sound_timer, 1),
+    CHIP8_LOCKSTEP_FIELD(key_waiting, 1),
+    CHIP8_LOCKSTEP_FIELD(key_wait_mask, 2),
+    CHIP8_LOCKSTEP_FIELD(rng, 4),
+    CHIP8_LOCKSTEP_FIELD(planes, 1),
+    CHIP8_LOCKSTEP_FIELD(pitch, 1),
+    CHIP8_LOCKSTEP_FIELD(audio_pattern, 1),
+    CHIP8_LOCKSTEP_FIELD(stack, 2),
+    CHIP8_LOCKSTEP_FIELD(registers, 1),
+    CHIP8_LOCKSTEP_FIELD(flags, 1),
+    CHIP8_LOCKSTEP_FIELD(display, sizeof(chip8_row_t)),
+};
+
+int chip8_lockstep_init(chip8_lockstep_t *lockstep, chip8_t *reference,
+                        chip8_t *candidate, unsigned int step)
+{
+    CHIP8_ASSERT_PTR(lockstep, CHIP8_INVALID_PTR_ERR);
+    CHIP8_ASSERT_PTR(reference, CHIP8_INVALID_PTR_ERR);
+    CHIP8_ASSERT_PTR(candidate, CHIP8_INVALID_PTR_ERR);
+
+    if (reference->mode != candidate->mode ||
+        reference->rom_hash != candidate->rom_hash) {
+        return CHIP8_ROM_ERR;
+    }
+    if (reference->run_handler != chip8_interpret) {
+        return CHIP8_ERR;
+    }
+
+    memset(lockstep, 0, sizeof(chip8_lockstep_t));
+    lockstep->reference = reference;
+    lockstep->candidate = candidate;
+    lockstep->step      = step ? step : CHIP8_LOCKSTEP_STEP;
+    if (lockstep->step > CHIP8_LOCKSTEP_MAX_STEP) {
+        lockstep->step = CHIP8_LOCKSTEP_MAX_STEP;
+    }
+
+    /* also marks every page dirty, so the first batch compares them all */
+    chip8_save_state(reference, &lockstep->agreed);
+    chip8_load_state(candidate, &lockstep->agreed);
+    memset(reference->dirty_map, 0xFF, sizeof(reference->dirty_map));
+
+    return CHIP8_OK;
+}
+
+/* compares the state and the pages written since, then starts over */
+static bool chip8_lockstep_match(chip8_lockstep_t *lockstep)
+{
+    chip8_t *reference = lockstep->reference;
+    chip8_t *candidate = lockstep->candidate;
+    uint32_t pages = (reference->memory_mask + 1) >> CHIP8_DIRTY_PAGE_SHIFT;
+    uint64_t dirty;
+    uint32_t page;
+    bool     match;
+
+    match = memcmp((const uint8_t *)reference + CHIP8_STATE_OFFSET,
+                   (const uint8_t *)candidate + CHIP8_STATE_OFFSET,
+                   offsetof(chip8_t, memory) - CHIP8_STATE_OFFSET) == 0;
+
+    for (uint32_t word = 0; word < (pages + 63) / 64; word++) {
+        dirty = reference->dirty_map[word] | candidate->dirty_map[word];
+        while (dirty && match) {
+            page = word * 64 + __builtin_ctzll(dirty);
+            dirty &= dirty - 1;
+
+            match = page >= pages ||
+                    memcmp(&reference->memory[page << CHIP8_DIRTY_PAGE_SHIFT],
+                           &candidate->memory[page << CHIP8_DIRTY_PAGE_SHIFT],
+                           CHIP8_LOCKSTEP_PAGE) == 0;
+        }
+    }
+
+    memset(reference->dirty_map, 0, sizeof(reference->dirty_map));
+    memset(candidate->dirty_map, 0, sizeof(candidate->dirty_map));
+
+    return match;
+}
+
+/**
+ * Rerun the batch from the last agreement with budgets of 1, 2, ... until
+ * the machines disagree again. A smaller budget can keep a fused sequence
+ * from running at all, so the divergence may only show at the full one.
+ * The reference steps one instruction at a time first, to record what it
+ * ran.
+ */
+static void chip8_lockstep_replay(chip8_lockstep_t *lockstep,
+                                  unsigned int budget)
+{
+    chip8_t     *reference = lockstep->reference;
+    chip8_t     *candidate = lockstep->candidate;
+    unsigned int executed;
+    unsigned int ran;
+    uint16_t     address;
+
+    for (unsigned int cycles = 1; cycles <= budget; cycles++) {
+        chip8_load_state(candidate, &lockstep->agreed);
+        chip8_load_state(reference, &lockstep->agreed);
+
+        lockstep->candidate_err = chip8_run(candidate, cycles, &executed);
+        lockstep->candidate_executed = executed;
+        lockstep->ops_count          = 0;
+
+        for (int err = CHIP8_OK;
+             lockstep->ops_count < executed && err == CHIP8_OK;) {
+            address = reference->program_counter & reference->memory_mask;
+            lockstep->ops[lockstep->ops_count].address = address;
+            lockstep->ops[lockstep->ops_count].command =
+                (CHIP8_MEM(reference, address) << 8) |
+                CHIP8_MEM(reference, address + 1);
+            lockstep->ops_count++;
+
+            err = chip8_interpret(reference, 1, NULL);
+        }
+
+        /* again as one batch, errors are only reported at the end of one */
+        chip8_load_state(reference, &lockstep->agreed);
+        lockstep->reference_err = chip8_run(reference, executed, &ran);
+
+        if (lockstep->reference_err != lockstep->candidate_err ||
+            ran != executed || !chip8_lockstep_match(lockstep)) {
+            return;
+        }
+    }
+}
+
+int chip8_lockstep_run(chip8_lockstep_t *lockstep, unsigned int cycles,
+                       unsigned int *executed)
+{
+    chip8_t     *reference = lockstep->reference;
+    chip8_t     *candidate = lockstep->candidate;
+    int          err       = CHIP8_OK;
+    int          reference_err;
+    unsigned int count = 0;
+    unsigned int budget;
+    unsigned int ran;
+    unsigned int reference_ran;
+
+    while (count < cycles && err == CHIP8_OK) {
+        budget = cycles - count < lockstep->step ? cycles - count
+                                                 : lockstep->step;
+
+        chip8_save_state(candidate, &lockstep->agreed);
+        err           = chip8_run(candidate, budget, &ran);
+        reference_err = chip8_run(reference, ran, &reference_ran);
+
+        if (reference_err != err || reference_ran != ran ||
+            !chip8_lockstep_match(lockstep)) {
+            chip8_lockstep_replay(lockstep, budget);
+            err = CHIP8_DIVERGED;
+            break;
+        }
+
+        count += ran;
+        lockstep->instructions += ran;
+        lockstep->batches++;
+    }
+
+    if (executed) {
+        *executed = count;
+    }
+
+    return err;
+}
+
+void chip8_lockstep_keypad_set(chip8_lockstep_t *lockstep, uint8_t key,
+                               chip8_key_state_t state)
+{
+    chip8_keypad_set(lockstep->reference, key, state);
+    chip8_keypad_set(lockstep->candidate, key, state);
+}
+
+void chip8_lockstep_tick_timers(chip8_lockstep_t *lockstep)
+{
+    chip8_tick_timers(lockstep->reference);
+    chip8_tick_timers(lockstep->candidate);
+}
+
+static void chip8_lockstep_write_element(FILE *out, const uint8_t *data,
+                                         size_t width)
+{
+    uint32_t value = 0;
+    uint64_t word;
+
+    /* display rows, one 64 pixel word after the other */
+    if (width > sizeof(value)) {
+        for (size_t i = 0; i < width; i += sizeof(word)) {
+            memcpy(&word, &data[i], sizeof(word));
+            fprintf(out, "%016llx", (unsigned long long)word);
+        }
+        return;
+    }
+
+    memcpy(&value, data, width);
+    fprintf(out, "%0*x", (int)width * 2, value);
+}
+
+static void chip8_lockstep_write_field(const chip8_lockstep_t *lockstep,
+                                       size_t field, FILE *out)
+{
+    const uint8_t *reference = (const uint8_t *)lockstep->reference +
+                               chip8_lockstep_fields[field].offset;
+    const uint8_t *candidate = (const uint8_t *)lockstep->candidate +
+                               chip8_lockstep_fields[field].offset;
+    size_t         width     = chip8_lockstep_fields[field].width;
+    size_t         count     = chip8_lockstep_fields[field].size / width;
+    unsigned int   shown     = 0;
+    char           name[32];
+
+    for (size_t i = 0; i < count && shown < CHIP8_LOCKSTEP_SHOWN; i++) {
+        if (memcmp(&reference[i * width], &candidate[i * width], width) == 0) {
+            continue;
+        }
+        shown++;
+
+        if (count == 1) {
+            snprintf(name, sizeof(name), "%s",
+                     chip8_lockstep_fields[field].name);
+        } else if (width == sizeof(chip8_row_t)) {
+            snprintf(name, sizeof(name), "%s[%zu][%zu]",
+                     chip8_lockstep_fields[field].name,
+                     i / CHIP8_DISPLAY_HEIGHT, i % CHIP8_DISPLAY_HEIGHT);
+        } else {
+            snprintf(name, sizeof(name), "%s[%zu]",
+                     chip8_lockstep_fields[field].name, i);
+        }
+        fprintf(out, "  %-16s ", name);
+        chip8_lockstep_write_element(out, &reference[i * width], width);
+        fputs("  ", out);
+        chip8_lockstep_write_element(out, &candidate[i * width], width);
+        fputc('\n', out);
+    }
+}
+
+int chip8_lockstep_write_report(const chip8_lockstep_t *lockstep, FILE *out)
+{
+    const chip8_t *reference = lockstep->reference;
+    const chip8_t *candidate = lockstep->candidate;
+    char           text[CHIP8_DISASM_SIZE];
+    unsigned int   shown = 0;
+
+    fprintf(out, "diverged after %llu agreed instructions, %u instruction "
+                 "batch:\n",
+            (unsigned long long)lockstep->instructions,
+            lockstep->candidate_executed);
+    for (unsigned int i = 0; i < lockstep->ops_count; i++) {
+        fprintf(out, "  %04X  %04X  %s\n", lockstep->ops[i].address,
+                lockstep->ops[i].command,
+                chip8_disasm(lockstep->ops[i].command, text, sizeof(text)));
+    }
+
+    fprintf(out, "%-18s reference / candidate\n", "differences:");
+    if (lockstep->reference_err != lockstep->candidate_err) {
+        fprintf(out, "  %-16s %d  %d\n", "error", lockstep->reference_err,
+                lockstep->candidate_err);
+    }
+    if (lockstep->ops_count != lockstep->candidate_executed) {
+        fprintf(out, "  %-16s %u  %u\n", "executed", lockstep->ops_count,
+                lockstep->candidate_executed);
+    }
+
+    for (size_t i = 0; i < sizeof(chip8_lockstep_fields) /
+                               sizeof(chip8_lockstep_fields[0]);
+         i++) {
+        chip8_lockstep_write_field(lockstep, i, out);
+    }
+
+    for (uint32_t address = 0; address <= reference->memory_mask &&
+                               shown < CHIP8_LOCKSTEP_SHOWN;
+         address++) {
+        if (reference->memory[address] != candidate->memory[address]) {
+            fprintf(out, "  memory[%04X]     %02x  %02x\n", address,
+                    reference->memory[address], candidate->memory[address]);
+            shown++;
+        }
+    }
+
+    return ferror(out) ? CHIP8_ERR : CHIP8_OK;
+}
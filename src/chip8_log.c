@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "chip8_log.h"
+
+/**
+ * One buffer per logging thread: a byte ring with a single producer (its
+ * thread) and a single consumer (the logger thread). Buffers are linked
+ * into a list on first use and only freed by chip8_log_cleanup(). A
+ * thread whose buffer belongs to an earlier init, as told by
+ * `generation`, gets a new one.
+ */
+typedef struct chip8_log_buffer
+{
+    struct chip8_log_buffer *next;
+    char                     name[16];
+    _Atomic uint32_t         head;
+    _Atomic uint32_t         tail;
+    _Atomic uint32_t         dropped;
+    char                     data[CHIP8_LOG_BUFFER];
+} chip8_log_buffer_t;
+
+static struct
+{
+    int                           fd;
+    pthread_t                     thread;
+    atomic_bool                   running;
+    atomic_bool                   stop;
+    _Atomic uint32_t              generation;
+    _Atomic(chip8_log_buffer_t *) buffers;
+    pthread_once_t                once;
+    struct timespec               start; /* line timestamps count from here */
+} chip8_logger = { .fd = STDERR_FILENO, .once = PTHREAD_ONCE_INIT };
+
+static _Thread_local chip8_log_buffer_t *chip8_log_local;
+static _Thread_local uint32_t            chip8_log_local_generation;
+static _Thread_local char                chip8_log_name[16] = "-";
+
+static const char chip8_log_levels[] = "TDIWE";
+
+void chip8_log_thread(const char *name)
+{
+    snprintf(chip8_log_name, sizeof(chip8_log_name), "%s", name);
+    if (chip8_log_local &&
+        chip8_log_local_generation ==
+            atomic_load_explicit(&chip8_logger.generation,
+                                 memory_order_acquire)) {
+        memcpy(chip8_log_local->name, chip8_log_name, sizeof(chip8_log_name));
+    }
+}
+
+static chip8_log_buffer_t *chip8_log_buffer(void)
+{
+    uint32_t            generation = atomic_load_explicit(
+        &chip8_logger.generation, memory_order_acquire);
+    chip8_log_buffer_t *buffer;
+
+    if (chip8_log_local && chip8_log_local_generation == generation) {
+        return chip8_log_local;
+    }
+
+    buffer = calloc(1, sizeof(chip8_log_buffer_t));
+    if (!buffer) {
+        return NULL;
+    }
+    memcpy(buffer->name, chip8_log_name, sizeof(chip8_log_name));
+
+    buffer->next = atomic_load_explicit(&chip8_logger.buffers,
+                                        memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(
+        &chip8_logger.buffers, &buffer->next, buffer, memory_order_release,
+        memory_order_relaxed)) {
+    }
+
+    chip8_log_local            = buffer;
+    chip8_log_local_generation = generation;
+
+    return buffer;
+}
+
+static void chip8_log_start(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &chip8_logger.start);
+}
+
+/* "<ms> <level> <thread>: ", the part every line shares */
+static int chip8_log_prefix(char *line, int level, const char *name)
+{
+    struct timespec now;
+    long            ms;
+
+    pthread_once(&chip8_logger.once, chip8_log_start);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ms = (now.tv_sec - chip8_logger.start.tv_sec) * 1000L +
+         (now.tv_nsec - chip8_logger.start.tv_nsec) / 1000000L;
+
+    return snprintf(line, CHIP8_LOG_LINE, "%6ld %c %s: ", ms,
+                    chip8_log_levels[level], name);
+}
+
+static size_t chip8_log_format(char *line, int level, const char *format,
+                               va_list args)
+{
+    int n = chip8_log_prefix(line, level, chip8_log_name);
+
+    n += vsnprintf(&line[n], CHIP8_LOG_LINE - n, format, args);
+    if (n > CHIP8_LOG_LINE - 1) {
+        n = CHIP8_LOG_LINE - 1;
+    }
+    line[n++] = '\n';
+
+    return n;
+}
+
+static void chip8_log_push(chip8_log_buffer_t *buffer, const char *line,
+                           size_t n)
+{
+    uint32_t head  = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+    uint32_t tail  = atomic_load_explicit(&buffer->tail, memory_order_acquire);
+    uint32_t at    = head & (CHIP8_LOG_BUFFER - 1);
+    size_t   first = CHIP8_LOG_BUFFER - at < n ? CHIP8_LOG_BUFFER - at : n;
+
+    if (n > CHIP8_LOG_BUFFER - (head - tail)) {
+        atomic_fetch_add_explicit(&buffer->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    memcpy(&buffer->data[at], line, first);
+    memcpy(buffer->data, &line[first], n - first);
+
+    atomic_store_explicit(&buffer->head, head + n, memory_order_release);
+}
+
+void chip8_log(int level, const char *format, ...)
+{
+    char                line[CHIP8_LOG_LINE + 1];
+    chip8_log_buffer_t *buffer = NULL;
+    size_t              n;
+    va_list             args;
+
+    va_start(args, format);
+    n = chip8_log_format(line, level, format, args);
+    va_end(args);
+
+    if (atomic_load_explicit(&chip8_logger.running, memory_order_acquire)) {
+        buffer = chip8_log_buffer();
+    }
+
+    if (buffer) {
+        chip8_log_push(buffer, line, n);
+    } else if (write(chip8_logger.fd, line, n) < 0) {
+        /* nowhere left to report it */
+    }
+}
+
+static void chip8_log_write(const char *data, size_t n)
+{
+    ssize_t written;
+
+    while (n > 0) {
+        written = write(chip8_logger.fd, data, n);
+        if (written <= 0) {
+            return;
+        }
+        data += written;
+        n -= written;
+    }
+}
+
+static void chip8_log_drain(chip8_log_buffer_t *buffer)
+{
+    uint32_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&buffer->tail, memory_order_relaxed);
+    uint32_t dropped;
+    uint32_t at;
+    uint32_t n;
+
+    while (tail != head) {
+        at = tail & (CHIP8_LOG_BUFFER - 1);
+        n  = CHIP8_LOG_BUFFER - at < head - tail ? CHIP8_LOG_BUFFER - at
+                                                 : head - tail;
+        chip8_log_write(&buffer->data[at], n);
+        tail += n;
+    }
+    atomic_store_explicit(&buffer->tail, tail, memory_order_release);
+
+    dropped = atomic_exchange_explicit(&buffer->dropped, 0,
+                                       memory_order_relaxed);
+    if (dropped) {
+        char line[CHIP8_LOG_LINE];
+        int  len = chip8_log_prefix(line, CHIP8_LOG_LEVEL_WARN, buffer->name);
+
+        len += snprintf(&line[len], CHIP8_LOG_LINE - len,
+                        "%u lines dropped\n", dropped);
+        chip8_log_write(line, len);
+    }
+}
+
+static void chip8_log_flush(void)
+{
+    chip8_log_buffer_t *buffer = atomic_load_explicit(&chip8_logger.buffers,
+                                                      memory_order_acquire);
+
+    for (; buffer; buffer = buffer->next) {
+        chip8_log_drain(buffer);
+    }
+}
+
+static void *chip8_log_thread_main(void *arg)
+{
+    const struct timespec period = {
+        .tv_sec  = 0,
+        .tv_nsec = CHIP8_LOG_PERIOD_MS * 1000000L,
+    };
+
+    (void)arg;
+
+    while (!atomic_load_explicit(&chip8_logger.stop, memory_order_acquire)) {
+        nanosleep(&period, NULL);
+        chip8_log_flush();
+    }
+
+    return NULL;
+}
+
+int chip8_log_init(int fd)
+{
+    if (atomic_load_explicit(&chip8_logger.running, memory_order_acquire)) {
+        return -1;
+    }
+
+    chip8_logger.fd = fd;
+    atomic_store_explicit(&chip8_logger.stop, false, memory_order_relaxed);
+    atomic_fetch_add_explicit(&chip8_logger.generation, 1,
+                              memory_order_release);
+
+    if (pthread_create(&chip8_logger.thread, NULL, chip8_log_thread_main,
+                       NULL) != 0) {
+        return -1;
+    }
+    atomic_store_explicit(&chip8_logger.running, true, memory_order_release);
+
+    return 0;
+}
+
+/**
+ * Call once the other threads have stopped logging: lines they push
+ * between the last flush and the stop would otherwise be lost with their
+ * buffers.
+ */
+void chip8_log_cleanup(void)
+{
+    chip8_log_buffer_t *buffer;
+    chip8_log_buffer_t *next;
+
+    if (!atomic_load_explicit(&chip8_logger.running, memory_order_acquire)) {
+        return;
+    }
+
+    atomic_store_explicit(&chip8_logger.running, false, memory_order_release);
+    atomic_store_explicit(&chip8_logger.stop, true, memory_order_release);
+    pthread_join(chip8_logger.thread, NULL);
+    chip8_log_flush();
+
+    buffer = atomic_exchange_explicit(&chip8_logger.buffers, NULL,
+                                      memory_order_acq_rel);
+    for (; buffer; buffer = next) {
+        next = buffer->next;
+        free(buffer);
+    }
+
+    chip8_logger.fd = STDERR_FILENO;
+}
@@ -0,0 +1,247 @@
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "chip8_perf.h"
+
+#define CHIP8_PERF_CACHE_MISS(cache)                                           \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) |                            \
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct
+{
+    uint32_t    type;
+    uint64_t    config;
+    const char *name;
+} chip8_perf_events[CHIP8_PERF_MAX] = {
+    [CHIP8_PERF_CYCLES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,
+                            "cycles" },
+    [CHIP8_PERF_INSTRUCTIONS] = { PERF_TYPE_HARDWARE,
+                                  PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+    [CHIP8_PERF_BRANCHES] = { PERF_TYPE_HARDWARE,
+                              PERF_COUNT_HW_BRANCH_INSTRUCTIONS, "branches" },
+    [CHIP8_PERF_BRANCH_MISSES] = { PERF_TYPE_HARDWARE,
+                                   PERF_COUNT_HW_BRANCH_MISSES,
+                                   "branch misses" },
+    [CHIP8_PERF_L1I_MISSES] = { PERF_TYPE_HW_CACHE,
+                                CHIP8_PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_L1I),
+                                "L1i misses" },
+    [CHIP8_PERF_L1D_MISSES] = { PERF_TYPE_HW_CACHE,
+                                CHIP8_PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D),
+                                "L1d misses" },
+};
+
+static int chip8_perf_run(chip8_t *chip8, unsigned int cycles,
+                          unsigned int *executed);
+
+static int chip8_perf_open(chip8_perf_event_t event, int group)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = chip8_perf_events[event].type;
+    attr.config         = chip8_perf_events[event].config;
+    attr.disabled       = group < 0; /* members follow the leader */
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_GROUP |
+                          PERF_FORMAT_TOTAL_TIME_ENABLED |
+                          PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+/* on the emulation thread, the group counts whoever opened it */
+static void chip8_perf_open_group(chip8_perf_t *perf)
+{
+    int leader = chip8_perf_open(CHIP8_PERF_CYCLES, -1);
+
+    perf->started = 1;
+    if (leader < 0) {
+        return;
+    }
+
+    perf->fds[CHIP8_PERF_CYCLES]   = leader;
+    perf->slots[CHIP8_PERF_CYCLES] = 0;
+    perf->opened                   = 1;
+
+    for (int i = CHIP8_PERF_CYCLES + 1; i < CHIP8_PERF_MAX; i++) {
+        perf->fds[i] = chip8_perf_open(i, leader);
+        if (perf->fds[i] >= 0) {
+            perf->slots[i] = perf->opened++;
+        }
+    }
+}
+
+int chip8_perf_init(chip8_perf_t *perf, chip8_t *chip8, const char *engine)
+{
+    int probe;
+
+    memset(perf, 0, sizeof(chip8_perf_t));
+    for (int i = 0; i < CHIP8_PERF_MAX; i++) {
+        perf->fds[i]   = -1;
+        perf->slots[i] = -1;
+    }
+
+    /* fail here rather than silently on the first batch */
+    probe = chip8_perf_open(CHIP8_PERF_CYCLES, -1);
+    if (probe < 0) {
+        return CHIP8_ERR;
+    }
+    close(probe);
+
+    perf->chip8        = chip8;
+    perf->engine       = engine;
+    perf->run_handler  = chip8->run_handler;
+    perf->run_ctx      = chip8->run_ctx;
+    chip8->run_handler = chip8_perf_run;
+    chip8->run_ctx     = perf;
+
+    return CHIP8_OK;
+}
+
+void chip8_perf_cleanup(chip8_perf_t *perf)
+{
+    if (!perf->chip8) {
+        return;
+    }
+
+    if (perf->chip8->run_ctx == perf) {
+        perf->chip8->run_handler = perf->run_handler;
+        perf->chip8->run_ctx     = perf->run_ctx;
+    }
+
+    for (int i = 0; i < CHIP8_PERF_MAX; i++) {
+        if (perf->fds[i] >= 0) {
+            close(perf->fds[i]);
+            perf->fds[i] = -1;
+        }
+    }
+
+    perf->opened = 0;
+    perf->chip8  = NULL;
+}
+
+/**
+ * Engines find their state in run_ctx, so the measured one gets its own
+ * back for the length of the batch.
+ */
+static int chip8_perf_run(chip8_t *chip8, unsigned int cycles,
+                          unsigned int *executed)
+{
+    chip8_perf_t *perf   = chip8->run_ctx;
+    int           leader = perf->fds[CHIP8_PERF_CYCLES];
+    unsigned int  count  = 0;
+    int           err;
+
+    if (!perf->started) {
+        chip8_perf_open_group(perf);
+        leader = perf->fds[CHIP8_PERF_CYCLES];
+    }
+
+    chip8->run_ctx = perf->run_ctx;
+
+    if (leader >= 0) {
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    err = perf->run_handler(chip8, cycles, &count);
+    if (leader >= 0) {
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    chip8->run_ctx = perf;
+
+    perf->executed += count;
+    perf->batches++;
+
+    if (executed) {
+        *executed = count;
+    }
+
+    return err;
+}
+
+int chip8_perf_read(const chip8_perf_t *perf, uint64_t counts[CHIP8_PERF_MAX])
+{
+    /* nr, time enabled, time running, then one value per event */
+    uint64_t data[3 + CHIP8_PERF_MAX];
+    ssize_t  size;
+
+    for (int i = 0; i < CHIP8_PERF_MAX; i++) {
+        counts[i] = 0;
+    }
+
+    if (perf->fds[CHIP8_PERF_CYCLES] < 0) {
+        return CHIP8_ERR;
+    }
+
+    size = read(perf->fds[CHIP8_PERF_CYCLES], data, sizeof(data));
+    if (size < (ssize_t)(3 * sizeof(uint64_t)) || data[0] != perf->opened) {
+        return CHIP8_ERR;
+    }
+
+    for (int i = 0; i < CHIP8_PERF_MAX; i++) {
+        if (perf->slots[i] < 0) {
+            continue;
+        }
+        counts[i] = data[3 + perf->slots[i]];
+        /* the group was multiplexed with other users of the PMU */
+        if (data[2] && data[2] < data[1]) {
+            counts[i] = (double)counts[i] * data[1] / data[2];
+        }
+    }
+
+    return CHIP8_OK;
+}
+
+static void chip8_perf_line(FILE *out, const char *name, uint64_t count,
+                            uint64_t executed)
+{
+    fprintf(out, "  %-14s %16llu %10.3f\n", name,
+            (unsigned long long)count,
+            executed ? (double)count / executed : 0.0);
+}
+
+int chip8_perf_write_report(const chip8_perf_t *perf, FILE *out)
+{
+    uint64_t counts[CHIP8_PERF_MAX];
+    uint64_t executed = perf->executed;
+
+    fprintf(out,
+            "perf: %s engine, %llu emulated instructions in %llu batches\n"
+            "  %-14s %16s %10s\n",
+            perf->engine, (unsigned long long)executed,
+            (unsigned long long)perf->batches, "host event", "count",
+            "per instr");
+
+    if (chip8_perf_read(perf, counts) != CHIP8_OK) {
+        fprintf(out, "  no counters were read\n");
+        return ferror(out) ? CHIP8_ERR : CHIP8_OK;
+    }
+
+    for (int i = 0; i < CHIP8_PERF_MAX; i++) {
+        if (perf->slots[i] >= 0) {
+            chip8_perf_line(out, chip8_perf_events[i].name, counts[i],
+                            executed);
+        }
+    }
+
+    if (perf->slots[CHIP8_PERF_INSTRUCTIONS] >= 0 &&
+        counts[CHIP8_PERF_CYCLES]) {
+        fprintf(out, "  IPC %.2f\n",
+                (double)counts[CHIP8_PERF_INSTRUCTIONS] /
+                    counts[CHIP8_PERF_CYCLES]);
+    }
+    if (perf->slots[CHIP8_PERF_BRANCHES] >= 0 &&
+        perf->slots[CHIP8_PERF_BRANCH_MISSES] >= 0 &&
+        counts[CHIP8_PERF_BRANCHES]) {
+        fprintf(out, "  branch miss rate %.2f%%\n",
+                100.0 * counts[CHIP8_PERF_BRANCH_MISSES] /
+                    counts[CHIP8_PERF_BRANCHES]);
+    }
+
+    return ferror(out) ? CHIP8_ERR : CHIP8_OK;
+}
@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8_profile.h"
+
+typedef struct
+{
+    uint16_t address;
+    uint64_t calls;
+    uint64_t inclusive;
+    uint64_t exclusive;
+} chip8_profile_row_t;
+
+int chip8_profile_init(chip8_profile_t *profile, chip8_t *chip8)
+{
+    memset(profile, 0, sizeof(chip8_profile_t));
+    profile->chip8                              = chip8;
+    profile->count                              = 1;
+    profile->nodes[CHIP8_PROFILE_ROOT].address = CHIP8_ROM_START;
+
+    chip8->profile = profile;
+
+    return CHIP8_OK;
+}
+
+void chip8_profile_cleanup(chip8_profile_t *profile)
+{
+    if (profile->chip8 && profile->chip8->profile == profile) {
+        profile->chip8->profile = NULL;
+    }
+
+    profile->chip8 = NULL;
+}
+
+/**
+ * Find or add the node for `address` called from `parent`. Calls are rare
+ * next to plain instructions and a subroutine has few distinct callees, so
+ * a sibling list is enough. The root is never a callee, which lets node 0
+ * double as the end of the list.
+ */
+uint16_t chip8_profile_child(chip8_profile_t *profile, uint16_t parent,
+                             uint16_t address)
+{
+    chip8_profile_node_t *node;
+    uint16_t              i;
+
+    for (i = profile->nodes[parent].child; i != CHIP8_PROFILE_ROOT;
+         i = profile->nodes[i].sibling) {
+        if (profile->nodes[i].address == address) {
+            return i;
+        }
+    }
+
+    /* out of nodes: keep charging the caller rather than lose the counts */
+    if (profile->count == CHIP8_PROFILE_NODES) {
+        profile->lost++;
+        return parent;
+    }
+
+    i    = profile->count++;
+    node = &profile->nodes[i];
+
+    node->address                 = address;
+    node->parent                  = parent;
+    node->child                   = CHIP8_PROFILE_ROOT;
+    node->sibling                 = profile->nodes[parent].child;
+    profile->nodes[parent].child = i;
+
+    return i;
+}
+
+#define CHIP8_PROFILE_NAME_SIZE (16)
+
+static const char *chip8_profile_name(char *name, int root, uint16_t address)
+{
+    if (root) {
+        return "rom";
+    }
+
+    snprintf(name, CHIP8_PROFILE_NAME_SIZE, "sub_%04X", address);
+
+    return name;
+}
+
+int chip8_profile_write_collapsed(const chip8_profile_t *profile, FILE *out)
+{
+    uint16_t path[CHIP8_PROFILE_NODES];
+    char     name[CHIP8_PROFILE_NAME_SIZE];
+    unsigned depth;
+
+    for (uint16_t i = 0; i < profile->count; i++) {
+        if (!profile->nodes[i].self) {
+            continue;
+        }
+
+        depth = 0;
+        for (uint16_t n = i; n != CHIP8_PROFILE_ROOT;
+             n = profile->nodes[n].parent) {
+            path[depth++] = n;
+        }
+
+        fputs(chip8_profile_name(name, 1, 0), out);
+        while (depth--) {
+            fprintf(out, ";%s",
+                    chip8_profile_name(name, 0,
+                                       profile->nodes[path[depth]].address));
+        }
+        fprintf(out, " %llu\n",
+                (unsigned long long)profile->nodes[i].self);
+    }
+
+    return ferror(out) ? CHIP8_ERR : CHIP8_OK;
+}
+
+/* a node below another call of the same subroutine is already inside it */
+static int chip8_profile_recursive(const chip8_profile_t *profile,
+                                   uint16_t node)
+{
+    uint16_t address = profile->nodes[node].address;
+
+    for (uint16_t n = profile->nodes[node].parent; n != CHIP8_PROFILE_ROOT;
+         n = profile->nodes[n].parent) {
+        if (profile->nodes[n].address == address) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int chip8_profile_by_address(const void *a, const void *b)
+{
+    const chip8_profile_row_t *x = a;
+    const chip8_profile_row_t *y = b;
+
+    return (x->address > y->address) - (x->address < y->address);
+}
+
+static int chip8_profile_by_inclusive(const void *a, const void *b)
+{
+    const chip8_profile_row_t *x = a;
+    const chip8_profile_row_t *y = b;
+
+    return (x->inclusive < y->inclusive) - (x->inclusive > y->inclusive);
+}
+
+int chip8_profile_write_report(const chip8_profile_t *profile, FILE *out)
+{
+    chip8_profile_row_t *rows;
+    uint64_t            *inclusive;
+    unsigned             count = 0;
+    char                 name[CHIP8_PROFILE_NAME_SIZE];
+
+    rows      = calloc(profile->count, sizeof(chip8_profile_row_t));
+    inclusive = calloc(profile->count, sizeof(uint64_t));
+    if (!rows || !inclusive) {
+        free(rows);
+        free(inclusive);
+        return CHIP8_ALLOC_ERR;
+    }
+
+    /* callees are always allocated after their caller */
+    for (uint16_t i = 0; i < profile->count; i++) {
+        inclusive[i] = profile->nodes[i].self;
+    }
+    for (uint16_t i = profile->count - 1; i != CHIP8_PROFILE_ROOT; i--) {
+        inclusive[profile->nodes[i].parent] += inclusive[i];
+    }
+
+    for (uint16_t i = 0; i < profile->count; i++) {
+        rows[i].address   = profile->nodes[i].address;
+        rows[i].calls     = profile->nodes[i].calls;
+        rows[i].exclusive = profile->nodes[i].self;
+        if (i == CHIP8_PROFILE_ROOT || !chip8_profile_recursive(profile, i)) {
+            rows[i].inclusive = inclusive[i];
+        }
+    }
+
+    /* the root keeps row 0, the call paths merge into one row per address */
+    qsort(rows + 1, profile->count - 1, sizeof(chip8_profile_row_t),
+          chip8_profile_by_address);
+    for (uint16_t i = 1; i < profile->count; i++) {
+        if (count && rows[count].address == rows[i].address) {
+            rows[count].calls += rows[i].calls;
+            rows[count].inclusive += rows[i].inclusive;
+            rows[count].exclusive += rows[i].exclusive;
+        } else {
+            rows[++count] = rows[i];
+        }
+    }
+    qsort(rows + 1, count, sizeof(chip8_profile_row_t),
+          chip8_profile_by_inclusive);
+
+    fprintf(out, "%-8s %10s %14s %14s\n", "sub", "calls", "inclusive",
+            "exclusive");
+    for (unsigned i = 0; i <= count; i++) {
+        fprintf(out, "%-8s %10llu %14llu %14llu\n",
+                chip8_profile_name(name, i == 0, rows[i].address),
+                (unsigned long long)rows[i].calls,
+                (unsigned long long)rows[i].inclusive,
+                (unsigned long long)rows[i].exclusive);
+    }
+    if (profile->lost) {
+        fprintf(out, "%u calls charged to their caller, out of nodes\n",
+                profile->lost);
+    }
+
+    free(rows);
+    free(inclusive);
+
+    return ferror(out) ? CHIP8_ERR : CHIP8_OK;
+}
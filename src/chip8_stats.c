@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "chip8_stats.h"
+
+#define CHIP8_STATS_FRAME_NS (1000000000ULL / CHIP8_TIMER_HZ)
+#define CHIP8_STATS_RETRIES  (1000)
+
+uint64_t chip8_stats_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+int chip8_stats_init(chip8_stats_t *stats, const chip8_t *chip8,
+                     const char *rom_file)
+{
+    chip8_stats_block_t *block;
+    const char          *name = strrchr(rom_file, '/');
+    int                  fd;
+
+    memset(stats, 0, sizeof(chip8_stats_t));
+    snprintf(stats->path, sizeof(stats->path), "%s/%s%d", CHIP8_STATS_DIR,
+             CHIP8_STATS_PREFIX, (int)getpid());
+
+    fd = open(stats->path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return CHIP8_ERR;
+    }
+    if (ftruncate(fd, sizeof(chip8_stats_block_t)) != 0) {
+        close(fd);
+        unlink(stats->path);
+        return CHIP8_ERR;
+    }
+
+    block = mmap(NULL, sizeof(chip8_stats_block_t), PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+    close(fd);
+    if (block == MAP_FAILED) {
+        unlink(stats->path);
+        return CHIP8_ERR;
+    }
+
+    block->version  = CHIP8_STATS_VERSION;
+    block->size     = sizeof(chip8_stats_block_t);
+    block->pid      = getpid();
+    block->mode     = chip8->mode;
+    block->rom_hash = chip8->rom_hash;
+    snprintf(block->rom, sizeof(block->rom), "%s", name ? name + 1 : rom_file);
+    atomic_init(&block->sequence, 0);
+
+    /* readers skip the block until the magic shows up */
+    atomic_thread_fence(memory_order_release);
+    memcpy(block->magic, CHIP8_STATS_MAGIC, sizeof(block->magic));
+
+    stats->block = block;
+
+    return CHIP8_OK;
+}
+
+void chip8_stats_cleanup(chip8_stats_t *stats)
+{
+    if (!stats->block) {
+        return;
+    }
+
+    munmap(stats->block, sizeof(chip8_stats_block_t));
+    unlink(stats->path);
+    stats->block = NULL;
+}
+
+/* the first tick fixes the origin, drift is measured against it */
+int chip8_stats_tick(chip8_stats_t *stats, uint64_t ticks, uint64_t now_ns)
+{
+    if (stats->ticks == 0) {
+        stats->start_ns = now_ns - ticks * CHIP8_STATS_FRAME_NS;
+    }
+    stats->ticks += ticks;
+
+    return stats->ticks - stats->publish_ticks >= CHIP8_STATS_PERIOD;
+}
+
+void chip8_stats_present(chip8_stats_t *stats, uint64_t now_ns)
+{
+    if (stats->present_ns) {
+        stats->frame_us[stats->frame_count++ % CHIP8_STATS_WINDOW] =
+            (now_ns - stats->present_ns) / 1000;
+    }
+    stats->present_ns = now_ns;
+    stats->frames++;
+}
+
+static void chip8_stats_percentiles(const chip8_stats_t *stats,
+                                    chip8_stats_sample_t *sample)
+{
+    uint32_t sorted[CHIP8_STATS_WINDOW];
+    uint32_t count = stats->frame_count < CHIP8_STATS_WINDOW
+                         ? stats->frame_count
+                         : CHIP8_STATS_WINDOW;
+
+    if (count == 0) {
+        return;
+    }
+
+    memcpy(sorted, stats->frame_us, count * sizeof(sorted[0]));
+    for (uint32_t i = 1; i < count; i++) {
+        uint32_t value = sorted[i];
+        uint32_t j     = i;
+
+        for (; j > 0 && sorted[j - 1] > value; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = value;
+    }
+
+    sample->frame_p50_us = sorted[count * 50 / 100];
+    sample->frame_p95_us = sorted[count * 95 / 100];
+    sample->frame_p99_us = sorted[count * 99 / 100];
+    sample->frame_max_us = sorted[count - 1];
+}
+
+void chip8_stats_publish(chip8_stats_t *stats, uint64_t instructions,
+                         uint16_t pc, uint8_t turbo, uint64_t now_ns)
+{
+    chip8_stats_block_t *block = stats->block;
+    chip8_stats_sample_t sample = {
+        .instructions = instructions,
+        .frames       = stats->frames,
+        .updated_ns   = now_ns,
+        .pc           = pc,
+        .turbo        = turbo,
+    };
+    uint32_t sequence;
+
+    if (!block) {
+        return;
+    }
+
+    if (stats->publish_ns && now_ns > stats->publish_ns) {
+        sample.mips = (double)(instructions - stats->instructions) * 1e3 /
+                      (now_ns - stats->publish_ns);
+    }
+    if (stats->ticks) {
+        sample.drift_us = ((int64_t)(now_ns - stats->start_ns) -
+                           (int64_t)(stats->ticks * CHIP8_STATS_FRAME_NS)) /
+                          1000;
+    }
+    chip8_stats_percentiles(stats, &sample);
+
+    stats->instructions  = instructions;
+    stats->publish_ns    = now_ns;
+    stats->publish_ticks = stats->ticks;
+
+    sequence = atomic_load_explicit(&block->sequence, memory_order_relaxed);
+    atomic_store_explicit(&block->sequence, sequence + 1,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&block->sample, &sample, sizeof(sample));
+    atomic_store_explicit(&block->sequence, sequence + 2,
+                          memory_order_release);
+}
+
+int chip8_stats_read(const chip8_stats_block_t *block,
+                     chip8_stats_sample_t *sample)
+{
+    uint32_t before;
+    uint32_t after;
+
+    for (int i = 0; i < CHIP8_STATS_RETRIES; i++) {
+        before = atomic_load_explicit(&block->sequence, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        memcpy(sample, &block->sample, sizeof(chip8_stats_sample_t));
+
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&block->sequence, memory_order_relaxed);
+        if (before == after) {
+            return CHIP8_OK;
+        }
+    }
+
+    return CHIP8_ERR;
+}
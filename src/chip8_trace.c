@@ -0,0 +1,367 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chip8_trace.h"
+
+#define CHIP8_TRACE_RECORD    (sizeof(chip8_trace_record_t))
+#define CHIP8_TRACE_RAW       (CHIP8_TRACE_CHUNK * CHIP8_TRACE_RECORD)
+#define CHIP8_TRACE_MIN_MATCH (4)
+#define CHIP8_TRACE_HASH_BITS (12)
+#define CHIP8_TRACE_MAX_SHIFT (0xFFFF) /* match offsets are 16 bit */
+
+static void *chip8_trace_thread(void *arg);
+
+static void chip8_trace_header(FILE *out, const chip8_t *chip8)
+{
+    chip8_trace_file_t header = {
+        .version     = CHIP8_TRACE_VERSION,
+        .record_size = CHIP8_TRACE_RECORD,
+        .mode        = chip8->mode,
+        .rom_hash    = chip8->rom_hash,
+    };
+
+    memcpy(header.magic, CHIP8_TRACE_MAGIC, sizeof(header.magic));
+    fwrite(&header, sizeof(header), 1, out);
+}
+
+int chip8_trace_init(chip8_trace_t *trace, chip8_t *chip8, const char *path)
+{
+    memset(trace, 0, sizeof(chip8_trace_t));
+    atomic_init(&trace->head, 0);
+    atomic_init(&trace->stop, false);
+    trace->chip8 = chip8;
+
+    trace->ring = calloc(CHIP8_TRACE_RING, CHIP8_TRACE_RECORD);
+    trace->path = strdup(path);
+    if (!trace->ring || !trace->path) {
+        return CHIP8_ALLOC_ERR;
+    }
+
+    trace->out = fopen(path, "wb");
+    if (!trace->out) {
+        return CHIP8_ERR;
+    }
+    chip8_trace_header(trace->out, chip8);
+
+    if (pthread_create(&trace->thread, NULL, chip8_trace_thread, trace) != 0) {
+        return CHIP8_ERR;
+    }
+    trace->started = 1;
+
+    chip8->trace = trace;
+
+    return CHIP8_OK;
+}
+
+void chip8_trace_cleanup(chip8_trace_t *trace)
+{
+    if (trace->chip8 && trace->chip8->trace == trace) {
+        trace->chip8->trace = NULL;
+    }
+
+    if (trace->started) {
+        atomic_store_explicit(&trace->stop, true, memory_order_release);
+        pthread_join(trace->thread, NULL);
+        trace->started = 0;
+    }
+
+    if (trace->out) {
+        fclose(trace->out);
+        trace->out = NULL;
+    }
+
+    free(trace->ring);
+    free(trace->path);
+    trace->ring  = NULL;
+    trace->path  = NULL;
+    trace->chip8 = NULL;
+}
+
+void chip8_trace_delta(uint8_t *records, size_t count)
+{
+    for (size_t i = count * CHIP8_TRACE_RECORD; i-- > CHIP8_TRACE_RECORD;) {
+        records[i] -= records[i - CHIP8_TRACE_RECORD];
+    }
+}
+
+void chip8_trace_undelta(uint8_t *records, size_t count)
+{
+    for (size_t i = CHIP8_TRACE_RECORD; i < count * CHIP8_TRACE_RECORD; i++) {
+        records[i] += records[i - CHIP8_TRACE_RECORD];
+    }
+}
+
+static size_t chip8_trace_length(uint8_t *dst, size_t op, size_t n)
+{
+    for (n -= 15; n >= 255; n -= 255) {
+        dst[op++] = 255;
+    }
+    dst[op++] = n;
+
+    return op;
+}
+
+/* one sequence: literals, then a match unless `match` is 0 (the last one) */
+static size_t chip8_trace_sequence(uint8_t *dst, size_t op,
+                                   const uint8_t *literals, size_t count,
+                                   size_t offset, size_t match)
+{
+    size_t token = op++;
+
+    dst[token] = (count < 15 ? count : 15) << 4;
+    if (count >= 15) {
+        op = chip8_trace_length(dst, op, count);
+    }
+    memcpy(&dst[op], literals, count);
+    op += count;
+
+    if (match) {
+        match -= CHIP8_TRACE_MIN_MATCH;
+        dst[token] |= match < 15 ? match : 15;
+        dst[op++] = offset & 0xFF;
+        dst[op++] = offset >> 8;
+        if (match >= 15) {
+            op = chip8_trace_length(dst, op, match);
+        }
+    }
+
+    return op;
+}
+
+/**
+ * Greedy LZ77 with a single-entry hash table over 4 byte prefixes, in
+ * LZ4's sequence format: a token with literal and match length nibbles,
+ * 255-run length extensions and 16 bit little endian offsets.
+ */
+size_t chip8_trace_pack(const uint8_t *src, size_t len, uint8_t *dst)
+{
+    uint32_t table[1 << CHIP8_TRACE_HASH_BITS] = { 0 };
+    size_t   ip     = 0;
+    size_t   anchor = 0;
+    size_t   op     = 0;
+
+    while (ip + CHIP8_TRACE_MIN_MATCH <= len) {
+        uint32_t value;
+        uint32_t hash;
+        size_t   ref;
+        size_t   match;
+
+        memcpy(&value, &src[ip], sizeof(value));
+        hash        = (value * 2654435761u) >> (32 - CHIP8_TRACE_HASH_BITS);
+        ref         = table[hash];
+        table[hash] = ip + 1; /* 0 marks an empty slot */
+
+        if (!ref || ip - (ref - 1) > CHIP8_TRACE_MAX_SHIFT ||
+            memcmp(&src[ref - 1], &src[ip], CHIP8_TRACE_MIN_MATCH) != 0) {
+            ip++;
+            continue;
+        }
+
+        ref--;
+        match = CHIP8_TRACE_MIN_MATCH;
+        while (ip + match < len && src[ref + match] == src[ip + match]) {
+            match++;
+        }
+
+        op     = chip8_trace_sequence(dst, op, &src[anchor], ip - anchor,
+                                      ip - ref, match);
+        ip    += match;
+        anchor = ip;
+    }
+
+    return chip8_trace_sequence(dst, op, &src[anchor], len - anchor, 0, 0);
+}
+
+static int chip8_trace_read_length(const uint8_t *src, size_t len, size_t *ip,
+                                   size_t *n)
+{
+    uint8_t byte;
+
+    do {
+        if (*ip >= len) {
+            return -1;
+        }
+        byte = src[(*ip)++];
+        *n += byte;
+    } while (byte == 255);
+
+    return 0;
+}
+
+long chip8_trace_unpack(const uint8_t *src, size_t len, uint8_t *dst,
+                        size_t size)
+{
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < len) {
+        uint8_t token = src[ip++];
+        size_t  count = token >> 4;
+        size_t  match = token & 0xF;
+        size_t  offset;
+
+        if (count == 15 && chip8_trace_read_length(src, len, &ip, &count)) {
+            return -1;
+        }
+        if (count > len - ip || count > size - op) {
+            return -1;
+        }
+        memcpy(&dst[op], &src[ip], count);
+        ip += count;
+        op += count;
+
+        if (ip == len) {
+            break;
+        }
+
+        if (len - ip < 2) {
+            return -1;
+        }
+        offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if (match == 15 && chip8_trace_read_length(src, len, &ip, &match)) {
+            return -1;
+        }
+        match += CHIP8_TRACE_MIN_MATCH;
+
+        if (offset == 0 || offset > op || match > size - op) {
+            return -1;
+        }
+        /* byte by byte, a match may overlap the bytes it produces */
+        for (size_t i = 0; i < match; i++, op++) {
+            dst[op] = dst[op - offset];
+        }
+    }
+
+    return op;
+}
+
+/* delta-codes `raw` in place */
+static void chip8_trace_frame(FILE *out, uint8_t *raw, uint32_t count)
+{
+    uint8_t             packed[CHIP8_TRACE_PACK_BOUND(CHIP8_TRACE_RAW)];
+    chip8_trace_frame_t frame = { .count = count };
+
+    chip8_trace_delta(raw, count);
+    frame.packed = chip8_trace_pack(raw, count * CHIP8_TRACE_RECORD, packed);
+
+    fwrite(&frame, sizeof(frame), 1, out);
+    fwrite(packed, 1, frame.packed, out);
+}
+
+static void chip8_trace_copy(const chip8_trace_t *trace, uint8_t *raw,
+                             uint64_t from, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(&raw[i * CHIP8_TRACE_RECORD],
+               &trace->ring[(from + i) & (CHIP8_TRACE_RING - 1)],
+               CHIP8_TRACE_RECORD);
+    }
+}
+
+/**
+ * Stream everything published so far. The producer may lap the writer
+ * while it copies, so `head` is read again afterwards and any record that
+ * could have been overwritten in the meantime is dropped.
+ */
+static void chip8_trace_drain(chip8_trace_t *trace)
+{
+    uint8_t  raw[CHIP8_TRACE_RAW];
+    uint64_t head;
+    uint64_t lost;
+    uint32_t count;
+
+    for (;;) {
+        head = atomic_load_explicit(&trace->head, memory_order_acquire);
+        if (head - trace->tail > CHIP8_TRACE_RING) {
+            trace->dropped += head - trace->tail - CHIP8_TRACE_RING;
+            trace->tail     = head - CHIP8_TRACE_RING;
+        }
+
+        count = head - trace->tail < CHIP8_TRACE_CHUNK ? head - trace->tail
+                                                       : CHIP8_TRACE_CHUNK;
+        if (count == 0) {
+            break;
+        }
+
+        chip8_trace_copy(trace, raw, trace->tail, count);
+
+        /**
+         * the producer may already be writing slot `head`, which holds
+         * record head - CHIP8_TRACE_RING until it publishes head + 1, so
+         * that record counts as lost too.
+         */
+        atomic_thread_fence(memory_order_acquire);
+        head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+        lost = head + 1 - trace->tail > CHIP8_TRACE_RING
+                   ? head + 1 - trace->tail - CHIP8_TRACE_RING
+                   : 0;
+        if (lost >= count) {
+            trace->dropped += count;
+            trace->tail += count;
+            continue;
+        }
+
+        chip8_trace_frame(trace->out, &raw[lost * CHIP8_TRACE_RECORD],
+                          count - lost);
+        trace->dropped += lost;
+        trace->tail += count;
+    }
+
+    fflush(trace->out);
+}
+
+static void *chip8_trace_thread(void *arg)
+{
+    chip8_trace_t        *trace  = arg;
+    const struct timespec period = {
+        .tv_sec  = 0,
+        .tv_nsec = CHIP8_TRACE_PERIOD_MS * 1000000L,
+    };
+
+    while (!atomic_load_explicit(&trace->stop, memory_order_acquire)) {
+        nanosleep(&period, NULL);
+        chip8_trace_drain(trace);
+    }
+
+    /* the cpu thread is gone by now, this catches its last records */
+    chip8_trace_drain(trace);
+
+    return NULL;
+}
+
+/**
+ * Runs on the cpu thread, which is the only writer of the ring, so the
+ * records cannot change underneath. Only the first failure is dumped.
+ */
+void chip8_trace_dump(chip8_trace_t *trace)
+{
+    uint8_t  raw[CHIP8_TRACE_RAW];
+    char     path[4096];
+    FILE    *out;
+    uint64_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    uint64_t from = head > CHIP8_TRACE_RING ? head - CHIP8_TRACE_RING : 0;
+    uint32_t count;
+
+    if (trace->dumped) {
+        return;
+    }
+    trace->dumped = 1;
+
+    snprintf(path, sizeof(path), "%s.dump", trace->path);
+    out = fopen(path, "wb");
+    if (!out) {
+        return;
+    }
+
+    chip8_trace_header(out, trace->chip8);
+    for (; from < head; from += count) {
+        count = head - from < CHIP8_TRACE_CHUNK ? head - from
+                                                : CHIP8_TRACE_CHUNK;
+        chip8_trace_copy(trace, raw, from, count);
+        chip8_trace_frame(out, raw, count);
+    }
+
+    fclose(out);
+}
@@ -0,0 +1,82 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "chip8_watchdog.h"
+
+#define CHIP8_WATCHDOG_PAGE (1u << CHIP8_DIRTY_PAGE_SHIFT)
+
+int chip8_watchdog_init(chip8_watchdog_t *watchdog, chip8_t *chip8)
+{
+    CHIP8_ASSERT_PTR(watchdog, CHIP8_INVALID_PTR_ERR);
+    CHIP8_ASSERT_PTR(chip8, CHIP8_INVALID_PTR_ERR);
+
+    memset(watchdog, 0, sizeof(chip8_watchdog_t));
+    watchdog->chip8 = chip8;
+
+    /* the first check hashes every page */
+    memset(chip8->dirty_map, 0xFF, sizeof(chip8->dirty_map));
+
+    return CHIP8_OK;
+}
+
+static uint64_t chip8_watchdog_hash(chip8_watchdog_t *watchdog)
+{
+    chip8_t *chip8 = watchdog->chip8;
+    uint32_t pages = (chip8->memory_mask + 1) >> CHIP8_DIRTY_PAGE_SHIFT;
+    uint64_t hash;
+
+    for (uint32_t page = 0; page < pages; page++) {
+        if (!(chip8->dirty_map[page >> 6] & (1ull << (page & 63)))) {
+            continue;
+        }
+        watchdog->pages[page] =
+            chip8_fnv1a(CHIP8_FNV_OFFSET,
+                        &chip8->memory[page << CHIP8_DIRTY_PAGE_SHIFT],
+                        CHIP8_WATCHDOG_PAGE);
+    }
+    memset(chip8->dirty_map, 0, sizeof(chip8->dirty_map));
+
+    /* everything from `draw` up to memory, display included */
+    hash = chip8_fnv1a(CHIP8_FNV_OFFSET,
+                       (const uint8_t *)chip8 + CHIP8_STATE_OFFSET,
+                       offsetof(chip8_t, memory) - CHIP8_STATE_OFFSET);
+
+    return chip8_fnv1a(hash, watchdog->pages, pages * sizeof(uint64_t));
+}
+
+int chip8_watchdog_check(chip8_watchdog_t *watchdog)
+{
+    chip8_t *chip8  = watchdog->chip8;
+    uint16_t keypad = chip8_keypad(chip8);
+    uint64_t hash   = chip8_watchdog_hash(watchdog);
+    uint32_t count  = watchdog->count < CHIP8_WATCHDOG_HISTORY
+                          ? watchdog->count
+                          : CHIP8_WATCHDOG_HISTORY;
+
+    watchdog->checks++;
+
+    /* a ROM that polls the keys is waiting for a press, not hung */
+    if (chip8->key_waiting || chip8->key_reads != watchdog->key_reads) {
+        watchdog->keypad    = keypad;
+        watchdog->key_reads = chip8->key_reads;
+        watchdog->count     = 0;
+        return CHIP8_OK;
+    }
+
+    /* a key press can lead anywhere, the states before it say nothing */
+    if (keypad != watchdog->keypad) {
+        watchdog->keypad = keypad;
+        watchdog->count  = 0;
+        count            = 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (watchdog->history[i] == hash) {
+            return CHIP8_STUCK;
+        }
+    }
+
+    watchdog->history[watchdog->count++ % CHIP8_WATCHDOG_HISTORY] = hash;
+
+    return CHIP8_OK;
+}
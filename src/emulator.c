@@ -1,52 +1,649 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include "chip8_log.h"
 #include "emulator.h"
 
-int emulator_init(emulator_t *emulator, char *rom_file)
+#define EMULATOR_NSEC_PER_SEC   (1000000000L)
+#define EMULATOR_FRAME_NSEC     (EMULATOR_NSEC_PER_SEC / CHIP8_TIMER_HZ)
+#define EMULATOR_MAX_LAG_FRAMES (4)
+#define EMULATOR_MAX_EVENTS     (8)
+
+static int  emulator_events_init(emulator_t *emulator);
+static void emulator_gdb_kill(void *ctx);
+
+/* a compiled module for this ROM wins, the decode cache runs the rest */
+static int emulator_engine_init(emulator_t *emulator)
+{
+    int err = CHIP8_ROM_ERR;
+
+    if (emulator->config.aot_dir) {
+        err = chip8_aot_init(&emulator->aot, &emulator->chip8,
+                             emulator->config.aot_dir);
+    }
+    if (err != CHIP8_OK) {
+        err = chip8_decoder_init(&emulator->decoder, &emulator->chip8,
+                                 emulator->config.fuse_mask);
+    }
+
+    return err;
+}
+
+static const char *emulator_engine_name(const emulator_t *emulator)
+{
+    if (emulator->chip8.run_ctx == &emulator->aot) {
+        return "aot";
+    }
+    if (emulator->chip8.run_ctx == &emulator->decoder) {
+        return "decode";
+    }
+    if (emulator->chip8.run_ctx == &emulator->cover) {
+        return "cover";
+    }
+
+    return "interpret";
+}
+
+int emulator_init(emulator_t *emulator, char *rom_file,
+                  const emulator_config_t *config)
 {
     int err;
 
+    emulator->config = *config;
+    if (emulator->config.frame_skip == 0) {
+        emulator->config.frame_skip = 1;
+    }
+    if (emulator->config.frame_skip > EMULATOR_MAX_FRAME_SKIP) {
+        emulator->config.frame_skip = EMULATOR_MAX_FRAME_SKIP;
+    }
+    if (emulator->config.run_ahead > EMULATOR_MAX_RUN_AHEAD) {
+        emulator->config.run_ahead = EMULATOR_MAX_RUN_AHEAD;
+    }
+
+    emulator->epoll_fd     = -1;
+    emulator->timer_fd     = -1;
+    emulator->cpu_timer_fd = -1;
+    emulator->signal_fd    = -1;
+    emulator->shutdown_fd  = -1;
+    emulator->wake_fd      = -1;
+    emulator->frame_fd     = -1;
+
+    /**
+     * must happen before SDL or the cpu thread start any thread, so the
+     * signals stay blocked everywhere and are only seen through signalfd.
+     */
+    err = emulator_events_init(emulator);
+    if (err != EMULATOR_SUCCESS) {
+        return err;
+    }
+
+    /* after the signal mask, the logger thread inherits it */
+    chip8_log_init(STDERR_FILENO);
+    chip8_log_thread("io");
+
     emulator->rom_file = rom_file;
-    err                = chip8_init(&emulator->chip8, rom_file);
+    err                = chip8_init(&emulator->chip8, rom_file,
+                                    emulator->config.mode);
+    if (err != CHIP8_OK) {
+        CHIP8_LOG_ERROR("cannot load %s: error %d", rom_file, err);
+        return EMULATOR_CHIP8_INIT_ERR;
+    }
+    CHIP8_LOG_INFO("%s: mode %d, hash %016llx", rom_file,
+                   emulator->config.mode,
+                   (unsigned long long)emulator->chip8.rom_hash);
+
+    /* chip8-top is a nice-to-have, run without it */
+    if (chip8_stats_init(&emulator->stats, &emulator->chip8, rom_file) !=
+        CHIP8_OK) {
+        CHIP8_LOG_WARN("stats: cannot create %s", emulator->stats.path);
+    }
+
+    /**
+     * the profiler and the trace see instructions in the interpreter, and
+     * would record speculative run-ahead frames that are rolled back.
+     */
+    if (emulator->config.profile || emulator->config.trace) {
+        emulator->config.run_ahead = 0;
+        err = CHIP8_OK;
+        if (emulator->config.profile) {
+            err = chip8_profile_init(&emulator->profile, &emulator->chip8);
+        }
+        if (err == CHIP8_OK && emulator->config.trace) {
+            err = chip8_trace_init(&emulator->trace, &emulator->chip8,
+                                   emulator->config.trace);
+        }
+        if (emulator->config.cover) {
+            CHIP8_LOG_WARN("cover: not collected with a profile or trace");
+        }
+    } else if (emulator->config.cover) {
+        /* speculative frames would count code the ROM never really ran */
+        emulator->config.run_ahead = 0;
+        err = chip8_cover_init(&emulator->cover, &emulator->chip8);
+    } else {
+        err = emulator_engine_init(emulator);
+    }
     if (err != CHIP8_OK) {
         return EMULATOR_CHIP8_INIT_ERR;
     }
 
+    /* wraps whichever engine won, so it has to come after them */
+    if (emulator->config.perf &&
+        chip8_perf_init(&emulator->perf, &emulator->chip8,
+                        emulator_engine_name(emulator)) != CHIP8_OK) {
+        CHIP8_LOG_WARN("perf: no counters: %s", strerror(errno));
+    }
+
+    if (emulator->config.watchdog) {
+        chip8_watchdog_init(&emulator->watchdog, &emulator->chip8);
+    }
+
+    /* run-ahead would trip breakpoints in frames that are then rolled back */
+    if (emulator->config.gdb) {
+        emulator->config.run_ahead = 0;
+        err = gdb_init(&emulator->gdb, &emulator->chip8, emulator->config.gdb,
+                       emulator_gdb_kill, emulator);
+        if (err != GDB_OK) {
+            CHIP8_LOG_ERROR("gdb: cannot listen on %s", emulator->config.gdb);
+            return EMULATOR_GDB_INIT_ERR;
+        }
+    }
+
     err = io_init(&emulator->io, 640, 320);
     if (err != IO_OK) {
         return EMULATOR_IO_INIT_ERR;
     }
 
-    emulator->shutdown = false;
+    emulator->io.chip8 = &emulator->chip8;
+    framebuffer_init(&emulator->framebuffer);
+    atomic_init(&emulator->shutdown, false);
+    atomic_init(&emulator->turbo, emulator->config.turbo);
+    atomic_init(&emulator->executed, 0);
+    atomic_init(&emulator->pc, emulator->chip8.program_counter);
+
+    return EMULATOR_SUCCESS;
+}
+
+static int emulator_epoll_add(emulator_t *emulator, int fd)
+{
+    struct epoll_event event = { .events = EPOLLIN, .data.fd = fd };
+
+    return epoll_ctl(emulator->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+static int emulator_events_init(emulator_t *emulator)
+{
+    sigset_t mask;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+
+    if (pthread_sigmask(SIG_BLOCK, &mask, NULL) != 0) {
+        return EMULATOR_EVENT_INIT_ERR;
+    }
+
+    emulator->signal_fd    = signalfd(-1, &mask, SFD_CLOEXEC);
+    emulator->timer_fd     = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    emulator->cpu_timer_fd = timerfd_create(CLOCK_MONOTONIC,
+                                            TFD_CLOEXEC | TFD_NONBLOCK);
+    emulator->shutdown_fd  = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    emulator->frame_fd     = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    emulator->wake_fd      = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    emulator->epoll_fd     = epoll_create1(EPOLL_CLOEXEC);
+
+    if (emulator->signal_fd < 0 || emulator->timer_fd < 0 ||
+        emulator->cpu_timer_fd < 0 || emulator->shutdown_fd < 0 ||
+        emulator->frame_fd < 0 || emulator->wake_fd < 0 ||
+        emulator->epoll_fd < 0) {
+        return EMULATOR_EVENT_INIT_ERR;
+    }
+
+    if (emulator_epoll_add(emulator, emulator->signal_fd) != 0 ||
+        emulator_epoll_add(emulator, emulator->timer_fd) != 0 ||
+        emulator_epoll_add(emulator, emulator->shutdown_fd) != 0 ||
+        emulator_epoll_add(emulator, emulator->frame_fd) != 0) {
+        return EMULATOR_EVENT_INIT_ERR;
+    }
 
     return EMULATOR_SUCCESS;
 }
 
+static uint64_t emulator_eventfd_read(int fd)
+{
+    uint64_t value = 0;
+
+    if (read(fd, &value, sizeof(value)) != sizeof(value)) {
+        return 0;
+    }
+
+    return value;
+}
+
+static void emulator_eventfd_write(int fd, uint64_t value)
+{
+    /* only fails when the counter would overflow, which is harmless here */
+    (void)!write(fd, &value, sizeof(value));
+}
+
+static void emulator_publish_frame(emulator_t *emulator, bool notify)
+{
+    frame_t *frame = framebuffer_back(&emulator->framebuffer);
+
+    memcpy(frame->planes, emulator->chip8.display, sizeof(frame->planes));
+    framebuffer_publish(&emulator->framebuffer);
+    emulator->chip8.draw = 0;
+
+    if (notify) {
+        emulator_eventfd_write(emulator->frame_fd, 1);
+    }
+}
+
+/* the cpu thread is the only writer, a plain store is enough */
+static inline void emulator_count(emulator_t *emulator, unsigned int executed)
+{
+    atomic_store_explicit(
+        &emulator->executed,
+        atomic_load_explicit(&emulator->executed, memory_order_relaxed) +
+            executed,
+        memory_order_relaxed);
+    atomic_store_explicit(&emulator->pc, emulator->chip8.program_counter,
+                          memory_order_relaxed);
+}
+
+/**
+ * Run one frame worth of instructions. When the ROM blocks on Fx0A and this
+ * is the last frame owed, park on the keypad futex until either a key
+ * arrives (and spend the rest of the frame budget right away) or the next
+ * tick is due. Only real frames are counted for chip8-top, a speculative
+ * run-ahead frame is rolled back.
+ */
+static int emulator_run_frame(emulator_t *emulator, bool last, bool real)
+{
+    chip8_t     *chip8  = &emulator->chip8;
+    unsigned int budget = CHIP8_CYCLES_PER_FRAME;
+    unsigned int executed;
+    int          err;
+
+    err = chip8_run(chip8, budget, &executed);
+    if (real) {
+        emulator_count(emulator, executed);
+    }
+    if (err != CHIP8_KEY_WAIT) {
+        return err;
+    }
+
+    budget -= executed;
+    if (last && chip8_keypad_wait(chip8, chip8->key_wait_mask,
+                                  EMULATOR_FRAME_NSEC) == CHIP8_OK) {
+        err = chip8_run(chip8, budget, &executed);
+        emulator_count(emulator, executed);
+    }
+
+    return err == CHIP8_KEY_WAIT ? CHIP8_OK : err;
+}
+
+/* after every config.watchdog real frames, speculative ones do not count */
+static int emulator_watchdog(emulator_t *emulator)
+{
+    if (!emulator->config.watchdog ||
+        ++emulator->frames < emulator->config.watchdog) {
+        return CHIP8_OK;
+    }
+    emulator->frames = 0;
+
+    return chip8_watchdog_check(&emulator->watchdog);
+}
+
+/**
+ * Fast-forward: run frame_skip emulated frames back to back without waiting
+ * for the wall clock. Timers still tick once per emulated frame, so the ROM
+ * sees normal 60 Hz time, just compressed. The frame is published without
+ * waking the io thread, which picks it up on its next tick; presents are
+ * therefore bounded by both frame_skip and the wall-clock frame rate.
+ */
+static int emulator_run_turbo(emulator_t *emulator)
+{
+    int err = CHIP8_OK;
+
+    for (unsigned int i = 0; i < emulator->config.frame_skip; i++) {
+        err = emulator_run_frame(emulator,
+                                 i == emulator->config.frame_skip - 1, true);
+        chip8_tick_timers(&emulator->chip8);
+        if (err == CHIP8_OK) {
+            err = emulator_watchdog(emulator);
+        }
+        if (err != CHIP8_OK) {
+            break;
+        }
+    }
+
+    if (emulator->chip8.draw) {
+        emulator_publish_frame(emulator, false);
+    }
+
+    return err;
+}
+
+/**
+ * Run-ahead: ROMs typically read keys in one frame and draw the result in
+ * the next, so what is on screen lags input by a frame or two. Snapshot the
+ * real state, speculatively run `run_ahead` more frames with the current
+ * keypad, show that future frame and roll back. The real timeline is never
+ * affected; the cost is run_ahead extra frames and two state copies.
+ */
+static void emulator_run_ahead(emulator_t *emulator)
+{
+    chip8_t *chip8 = &emulator->chip8;
+
+    chip8_save_state(chip8, &emulator->run_ahead);
+
+    /* an error in the future is not an error yet, it is met for real later */
+    for (unsigned int i = 0; i < emulator->config.run_ahead; i++) {
+        if (emulator_run_frame(emulator, false, false) != CHIP8_OK) {
+            break;
+        }
+        chip8_tick_timers(chip8);
+    }
+
+    if (chip8->draw) {
+        emulator_publish_frame(emulator, true);
+    }
+
+    chip8_load_state(chip8, &emulator->run_ahead);
+
+    /* the speculative frame already contains any real draw */
+    chip8->draw = 0;
+}
+
+/**
+ * Emulation thread: sleeps in poll() on its own 60 Hz timerfd, then runs
+ * as many frames worth of instructions as the timer expired, ticks the
+ * timers and hands the display over. The io thread never sits between the
+ * clock and the machine, so a slow present or a blocked event pump delays
+ * nothing here; wake_fd only interrupts the wait for shutdown or a switch
+ * into fast-forward.
+ */
+static void *emulator_cpu_thread(void *arg)
+{
+    emulator_t   *emulator = arg;
+    struct pollfd fds[]    = {
+        { .fd = emulator->cpu_timer_fd, .events = POLLIN },
+        { .fd = emulator->wake_fd, .events = POLLIN },
+    };
+    uint64_t frames;
+    int      err = CHIP8_OK;
+
+    chip8_log_thread("cpu");
+
+    while (err == CHIP8_OK || err == CHIP8_BREAK) {
+        /* batch boundary: the only place a debugger can stop the machine */
+        if (gdb_halt_requested(&emulator->gdb, err)) {
+            gdb_stop(&emulator->gdb, err);
+            err = CHIP8_OK;
+        }
+
+        if (atomic_load_explicit(&emulator->turbo, memory_order_relaxed)) {
+            if (atomic_load_explicit(&emulator->shutdown,
+                                     memory_order_acquire)) {
+                break;
+            }
+
+            /* fast-forward keeps its own pace, drop the ticks it ran past */
+            emulator_eventfd_read(emulator->cpu_timer_fd);
+            err = emulator_run_turbo(emulator);
+            continue;
+        }
+
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+            err = CHIP8_ERR;
+            break;
+        }
+        emulator_eventfd_read(emulator->wake_fd);
+        frames = emulator_eventfd_read(emulator->cpu_timer_fd);
+
+        if (atomic_load_explicit(&emulator->shutdown, memory_order_acquire)) {
+            break;
+        }
+        if (!frames) {
+            continue;
+        }
+
+        /**
+         * do not try to catch up after this thread itself stalled (e.g.
+         * stopped in a debugger)
+         */
+        if (frames > EMULATOR_MAX_LAG_FRAMES) {
+            frames = EMULATOR_MAX_LAG_FRAMES;
+        }
+
+        while (frames-- && err == CHIP8_OK) {
+            err = emulator_run_frame(emulator, frames == 0, true);
+            chip8_tick_timers(&emulator->chip8);
+            if (err == CHIP8_OK) {
+                err = emulator_watchdog(emulator);
+            }
+        }
+
+        if (err == CHIP8_OK && emulator->config.run_ahead) {
+            emulator_run_ahead(emulator);
+        } else if (emulator->chip8.draw) {
+            emulator_publish_frame(emulator, true);
+        }
+    }
+
+    if (err == CHIP8_STUCK) {
+        CHIP8_LOG_WARN("watchdog: stuck at %03x after %u checks",
+                       emulator->chip8.program_counter,
+                       emulator->watchdog.checks);
+    } else if (err != CHIP8_OK && err != CHIP8_BREAK) {
+        CHIP8_LOG_ERROR("stopped at %03x: error %d",
+                        emulator->chip8.program_counter, err);
+    }
+    emulator->cpu_err = err;
+    emulator_signal_shutdown(emulator);
+
+    return NULL;
+}
+
+static int emulator_timer_start(emulator_t *emulator)
+{
+    struct itimerspec spec = {
+        .it_interval = { .tv_sec = 0, .tv_nsec = EMULATOR_FRAME_NSEC },
+        .it_value    = { .tv_sec = 0, .tv_nsec = EMULATOR_FRAME_NSEC },
+    };
+
+    if (timerfd_settime(emulator->timer_fd, 0, &spec, NULL) != 0) {
+        return -1;
+    }
+
+    return timerfd_settime(emulator->cpu_timer_fd, 0, &spec, NULL);
+}
+
+static void emulator_present(emulator_t *emulator)
+{
+    const frame_t *frame;
+
+    emulator_eventfd_read(emulator->frame_fd);
+
+    frame = framebuffer_acquire(&emulator->framebuffer);
+    if (frame) {
+        io_present(&emulator->io, frame);
+        chip8_stats_present(&emulator->stats, chip8_stats_now());
+    }
+}
+
+static void emulator_stats_tick(emulator_t *emulator, uint64_t ticks)
+{
+    uint64_t now = chip8_stats_now();
+
+    if (chip8_stats_tick(&emulator->stats, ticks, now)) {
+        chip8_stats_publish(
+            &emulator->stats,
+            atomic_load_explicit(&emulator->executed, memory_order_relaxed),
+            atomic_load_explicit(&emulator->pc, memory_order_relaxed),
+            atomic_load_explicit(&emulator->turbo, memory_order_relaxed),
+            now);
+    }
+}
+
+/**
+ * io loop: blocks in epoll_wait until the frame timer, a published frame,
+ * a signal or a shutdown request arrives. SDL events are pumped on every
+ * tick, which bounds input latency to one frame without ever spinning.
+ */
 int emulator_cycle(emulator_t *emulator)
 {
-    int err;
+    struct epoll_event events[EMULATOR_MAX_EVENTS];
+    uint64_t           ticks;
+    int                count;
+    int                err;
 
-    if (!emulator->chip8.cycle_handler || emulator->io.cycle_handler) {
+    if (!emulator->chip8.cycle_handler || !emulator->io.cycle_handler) {
         return EMULATOR_ERR;
     }
 
-    while (!emulator->shutdown) {
-        err = emulator->chip8.cycle_handler(&emulator->chip8);
-        err = emulator->io.cycle_handler(&emulator->io);
+    if (pthread_create(&emulator->cpu_thread, NULL, emulator_cpu_thread,
+                       emulator) != 0) {
+        return EMULATOR_THREAD_ERR;
+    }
+
+    if (emulator_timer_start(emulator) != 0) {
+        emulator_signal_shutdown(emulator);
+    }
+
+    while (!atomic_load_explicit(&emulator->shutdown, memory_order_acquire)) {
+        count = epoll_wait(emulator->epoll_fd, events, EMULATOR_MAX_EVENTS, -1);
+        if (count < 0 && errno != EINTR) {
+            emulator_signal_shutdown(emulator);
+        }
+
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == emulator->timer_fd) {
+                ticks = emulator_eventfd_read(emulator->timer_fd);
+                emulator_stats_tick(emulator, ticks);
 
-        if (err == IO_QUIT) {
-            emulator->shutdown = true;
+                err = emulator->io.cycle_handler(&emulator->io);
+                if (err == IO_QUIT) {
+                    emulator_signal_shutdown(emulator);
+                } else if (err == IO_TURBO_TOGGLE) {
+                    /* the io thread is the only writer */
+                    atomic_store(&emulator->turbo,
+                                 !atomic_load(&emulator->turbo));
+                    emulator_eventfd_write(emulator->wake_fd, 1);
+                }
+
+                if (atomic_load_explicit(&emulator->turbo,
+                                         memory_order_relaxed)) {
+                    emulator_present(emulator);
+                }
+            } else if (fd == emulator->frame_fd) {
+                emulator_present(emulator);
+            } else if (fd == emulator->signal_fd) {
+                struct signalfd_siginfo info;
+
+                (void)!read(emulator->signal_fd, &info, sizeof(info));
+                emulator_signal_shutdown(emulator);
+            } else if (fd == emulator->shutdown_fd) {
+                emulator_eventfd_read(emulator->shutdown_fd);
+            }
         }
     }
 
-    return EMULATOR_SUCCESS;
+    /* wake the cpu thread so it observes the shutdown flag */
+    gdb_shutdown(&emulator->gdb);
+    emulator_eventfd_write(emulator->wake_fd, 1);
+    pthread_join(emulator->cpu_thread, NULL);
+
+    switch (emulator->cpu_err) {
+    case CHIP8_OK:
+    case CHIP8_BREAK:
+        return EMULATOR_SUCCESS;
+    case CHIP8_STUCK:
+        return EMULATOR_STUCK;
+    default:
+        return EMULATOR_CPU_ERR;
+    }
+}
+
+static void emulator_close_fd(int *fd)
+{
+    if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+static void emulator_profile_write(emulator_t *emulator)
+{
+    FILE *out = fopen(emulator->config.profile, "w");
+
+    if (!out) {
+        CHIP8_LOG_ERROR("profile: cannot write %s", emulator->config.profile);
+    } else {
+        chip8_profile_write_collapsed(&emulator->profile, out);
+        fclose(out);
+    }
+
+    chip8_profile_write_report(&emulator->profile, stderr);
 }
 
 void emulator_cleanup(emulator_t *emulator)
 {
+    if (emulator->config.profile && emulator->profile.chip8) {
+        emulator_profile_write(emulator);
+    }
+
+    if (emulator->config.cover && emulator->cover.chip8 &&
+        chip8_cover_save(&emulator->cover, emulator->config.cover) !=
+            CHIP8_OK) {
+        CHIP8_LOG_ERROR("cover: cannot merge into %s", emulator->config.cover);
+    }
+
+    gdb_cleanup(&emulator->gdb);
+    if (emulator->perf.chip8) {
+        chip8_perf_write_report(&emulator->perf, stderr);
+    }
+    chip8_perf_cleanup(&emulator->perf);
+    chip8_cover_cleanup(&emulator->cover);
+    chip8_stats_cleanup(&emulator->stats);
+    chip8_trace_cleanup(&emulator->trace);
+    chip8_profile_cleanup(&emulator->profile);
+    chip8_aot_cleanup(&emulator->aot);
+    chip8_decoder_cleanup(&emulator->decoder);
     chip8_cleanup(&emulator->chip8);
     io_cleanup(&emulator->io);
+
+    emulator_close_fd(&emulator->epoll_fd);
+    emulator_close_fd(&emulator->timer_fd);
+    emulator_close_fd(&emulator->cpu_timer_fd);
+    emulator_close_fd(&emulator->signal_fd);
+    emulator_close_fd(&emulator->shutdown_fd);
+    emulator_close_fd(&emulator->wake_fd);
+    emulator_close_fd(&emulator->frame_fd);
+
+    /* last, every other thread has been joined */
+    chip8_log_cleanup();
 }
 
 void emulator_signal_shutdown(emulator_t *emulator)
 {
-    emulator->shutdown = true;
-}
\ No newline at end of file
+    atomic_store_explicit(&emulator->shutdown, true, memory_order_release);
+    emulator_eventfd_write(emulator->shutdown_fd, 1);
+}
+
+static void emulator_gdb_kill(void *ctx)
+{
+    emulator_signal_shutdown(ctx);
+}
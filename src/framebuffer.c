@@ -0,0 +1,44 @@
+#include <string.h>
+
+#include "framebuffer.h"
+
+#define FRAMEBUFFER_FRESH      (0x4)
+#define FRAMEBUFFER_INDEX_MASK (0x3)
+
+void framebuffer_init(framebuffer_t *fb)
+{
+    memset(fb->frames, 0, sizeof(fb->frames));
+    fb->back  = 0;
+    fb->front = 2;
+    atomic_init(&fb->middle, 1);
+}
+
+frame_t *framebuffer_back(framebuffer_t *fb)
+{
+    return &fb->frames[fb->back];
+}
+
+void framebuffer_publish(framebuffer_t *fb)
+{
+    unsigned int prev;
+
+    prev = atomic_exchange_explicit(&fb->middle, fb->back | FRAMEBUFFER_FRESH,
+                                    memory_order_acq_rel);
+    fb->back = prev & FRAMEBUFFER_INDEX_MASK;
+}
+
+const frame_t *framebuffer_acquire(framebuffer_t *fb)
+{
+    unsigned int prev;
+
+    if (!(atomic_load_explicit(&fb->middle, memory_order_relaxed) &
+          FRAMEBUFFER_FRESH)) {
+        return NULL;
+    }
+
+    prev = atomic_exchange_explicit(&fb->middle, fb->front,
+                                    memory_order_acq_rel);
+    fb->front = prev & FRAMEBUFFER_INDEX_MASK;
+
+    return &fb->frames[fb->front];
+}
@@ -0,0 +1,844 @@
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "gdb.h"
+#include "chip8_code.h"
+
+#define GDB_LINE_SIZE (1 << CHIP8_CODE_LINE_SHIFT)
+
+#define GDB_REG_I     (16)
+#define GDB_REG_PC    (17)
+#define GDB_REG_SP    (18)
+#define GDB_REG_DT    (19)
+#define GDB_REG_ST    (20)
+#define GDB_REG_COUNT (21)
+
+/* GDB's Z packet types */
+#define GDB_Z_SOFTWARE (0)
+#define GDB_Z_HARDWARE (1)
+#define GDB_Z_WRITE    (2)
+
+#define GDB_REG_8(n) "<reg name=\"v" #n "\" bitsize=\"8\" type=\"uint8\"/>"
+
+static const char gdb_target_xml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\"><feature name=\"org.chip8.core\">"
+    GDB_REG_8(0) GDB_REG_8(1) GDB_REG_8(2) GDB_REG_8(3)
+    GDB_REG_8(4) GDB_REG_8(5) GDB_REG_8(6) GDB_REG_8(7)
+    GDB_REG_8(8) GDB_REG_8(9) GDB_REG_8(a) GDB_REG_8(b)
+    GDB_REG_8(c) GDB_REG_8(d) GDB_REG_8(e) GDB_REG_8(f)
+    "<reg name=\"i\" bitsize=\"16\" type=\"data_ptr\"/>"
+    "<reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+    "<reg name=\"sp\" bitsize=\"16\" type=\"uint16\"/>"
+    "<reg name=\"dt\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"st\" bitsize=\"8\" type=\"uint8\"/>"
+    "</feature></target>";
+
+enum
+{
+    GDB_RX_IDLE = 0,
+    GDB_RX_DATA,
+    GDB_RX_CHECKSUM,
+};
+
+static void *gdb_thread(void *arg);
+
+/**
+ * A stale socket left by an earlier run is replaced, anything else at the
+ * path is left alone and fails the listen: a mistyped path must not cost
+ * the user a file.
+ */
+static int gdb_listen(const char *address)
+{
+    int fd;
+    int one = 1;
+
+    if (strchr(address, '/')) {
+        struct sockaddr_un un = { .sun_family = AF_UNIX };
+        struct stat        st;
+
+        if (strlen(address) >= sizeof(un.sun_path)) {
+            return -1;
+        }
+        strcpy(un.sun_path, address);
+
+        if (lstat(address, &st) == 0) {
+            if (!S_ISSOCK(st.st_mode)) {
+                errno = EEXIST;
+                return -1;
+            }
+            if (unlink(address) != 0) {
+                return -1;
+            }
+        } else if (errno != ENOENT) {
+            return -1;
+        }
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && bind(fd, (struct sockaddr *)&un, sizeof(un)) != 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        struct sockaddr_in in = {
+            .sin_family      = AF_INET,
+            .sin_port        = htons(strtoul(address, NULL, 10)),
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        };
+
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, (struct sockaddr *)&in, sizeof(in)) != 0) {
+                close(fd);
+                return -1;
+            }
+        }
+    }
+
+    if (fd >= 0 && listen(fd, 1) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int gdb_init(gdb_t *gdb, chip8_t *chip8, const char *address,
+             gdb_kill_handler kill, void *ctx)
+{
+    gdb->chip8     = chip8;
+    gdb->kill      = kill;
+    gdb->kill_ctx  = ctx;
+    gdb->client_fd = -1;
+    gdb->halted    = false;
+    gdb->resume    = GDB_RESUME_NONE;
+    gdb->signal    = SIGTRAP;
+    gdb->interrupt = false;
+    gdb->started   = false;
+    atomic_init(&gdb->halt, true);
+    atomic_init(&gdb->shutdown, false);
+    pthread_mutex_init(&gdb->lock, NULL);
+    pthread_cond_init(&gdb->cond, NULL);
+    chip8_debug_init(&gdb->debug, chip8);
+
+    gdb->listen_fd = gdb_listen(address);
+    gdb->wake_fd   = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (gdb->listen_fd < 0 || gdb->wake_fd < 0) {
+        return GDB_SOCKET_ERR;
+    }
+
+    if (pthread_create(&gdb->thread, NULL, gdb_thread, gdb) != 0) {
+        return GDB_THREAD_ERR;
+    }
+    gdb->started = true;
+
+    return GDB_OK;
+}
+
+static void gdb_wake(gdb_t *gdb)
+{
+    uint64_t one = 1;
+
+    (void)!write(gdb->wake_fd, &one, sizeof(one));
+}
+
+/**
+ * The cpu thread parks here with the machine at an instruction boundary.
+ * Clearing `halt` first means an interrupt that arrives while it is
+ * parked is kept for the next batch instead of being lost on resume.
+ */
+void gdb_stop(gdb_t *gdb, int err)
+{
+    unsigned int executed;
+
+    atomic_store_explicit(&gdb->halt, false, memory_order_relaxed);
+
+    pthread_mutex_lock(&gdb->lock);
+    gdb->signal    = gdb->interrupt && err != CHIP8_BREAK ? SIGINT : SIGTRAP;
+    gdb->interrupt = false;
+
+    for (;;) {
+        gdb->halted = true;
+        pthread_cond_broadcast(&gdb->cond);
+        gdb_wake(gdb);
+
+        while (gdb->resume == GDB_RESUME_NONE &&
+               !atomic_load_explicit(&gdb->shutdown, memory_order_acquire)) {
+            pthread_cond_wait(&gdb->cond, &gdb->lock);
+        }
+
+        if (gdb->resume != GDB_RESUME_STEP ||
+            atomic_load_explicit(&gdb->shutdown, memory_order_acquire)) {
+            break;
+        }
+
+        gdb->resume = GDB_RESUME_NONE;
+        pthread_mutex_unlock(&gdb->lock);
+
+        err = chip8_run(gdb->chip8, 1, &executed);
+
+        pthread_mutex_lock(&gdb->lock);
+        gdb->signal = err == CHIP8_OK || err == CHIP8_BREAK ? SIGTRAP
+                                                            : SIGSEGV;
+    }
+
+    gdb->resume = GDB_RESUME_NONE;
+    pthread_mutex_unlock(&gdb->lock);
+}
+
+/* gdb thread: bring the cpu thread to a stop, returns false on shutdown */
+static bool gdb_halt(gdb_t *gdb)
+{
+    pthread_mutex_lock(&gdb->lock);
+    if (!gdb->halted) {
+        atomic_store_explicit(&gdb->halt, true, memory_order_release);
+    }
+    while (!gdb->halted &&
+           !atomic_load_explicit(&gdb->shutdown, memory_order_acquire)) {
+        pthread_cond_wait(&gdb->cond, &gdb->lock);
+    }
+    pthread_mutex_unlock(&gdb->lock);
+
+    return !atomic_load_explicit(&gdb->shutdown, memory_order_acquire);
+}
+
+static void gdb_resume(gdb_t *gdb, gdb_resume_t resume)
+{
+    pthread_mutex_lock(&gdb->lock);
+    gdb->halted = false;
+    gdb->resume = resume;
+    pthread_cond_broadcast(&gdb->cond);
+    pthread_mutex_unlock(&gdb->lock);
+}
+
+static const char gdb_hex[] = "0123456789abcdef";
+
+static int gdb_unhex(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+static char *gdb_put_hex(char *out, uint32_t value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--) {
+        *out++ = gdb_hex[(value >> (8 * i + 4)) & 0xF];
+        *out++ = gdb_hex[(value >> (8 * i)) & 0xF];
+    }
+
+    return out;
+}
+
+/* parse `bytes` big endian bytes of hex, -1 on malformed input */
+static int64_t gdb_get_hex(const char **in, int bytes)
+{
+    int64_t value = 0;
+
+    for (int i = 0; i < 2 * bytes; i++) {
+        int digit = gdb_unhex((*in)[i]);
+
+        if (digit < 0) {
+            return -1;
+        }
+        value = (value << 4) | digit;
+    }
+    *in += 2 * bytes;
+
+    return value;
+}
+
+static void gdb_send(gdb_t *gdb, const char *data, size_t length)
+{
+    char    frame[GDB_PACKET_SIZE + 4];
+    uint8_t checksum = 0;
+
+    if (length > GDB_PACKET_SIZE) {
+        length = GDB_PACKET_SIZE;
+    }
+
+    frame[0] = '$';
+    for (size_t i = 0; i < length; i++) {
+        frame[i + 1] = data[i];
+        checksum += (uint8_t)data[i];
+    }
+    frame[length + 1] = '#';
+    gdb_put_hex(&frame[length + 2], checksum, 1);
+
+    (void)!write(gdb->client_fd, frame, length + 4);
+}
+
+static void gdb_send_str(gdb_t *gdb, const char *data)
+{
+    gdb_send(gdb, data, strlen(data));
+}
+
+static void gdb_send_stop(gdb_t *gdb)
+{
+    char reply[32];
+
+    if (gdb->debug.stop.reason == CHIP8_STOP_WATCHPOINT &&
+        gdb->signal == SIGTRAP) {
+        snprintf(reply, sizeof(reply), "T%02xwatch:%x;", SIGTRAP,
+                 gdb->debug.stop.address);
+    } else {
+        snprintf(reply, sizeof(reply), "S%02x", gdb->signal);
+    }
+
+    gdb_send_str(gdb, reply);
+}
+
+static int gdb_reg_bytes(unsigned int reg)
+{
+    return reg >= GDB_REG_I && reg <= GDB_REG_SP ? 2 : 1;
+}
+
+static uint32_t gdb_reg_read(const chip8_t *chip8, unsigned int reg)
+{
+    if (reg < CHIP8_REGISTERS_SIZE) {
+        return chip8->registers[reg];
+    }
+
+    switch (reg) {
+    case GDB_REG_I:
+        return chip8->i_register;
+    case GDB_REG_PC:
+        return chip8->program_counter;
+    case GDB_REG_SP:
+        return chip8->stack_pointer;
+    case GDB_REG_DT:
+        return chip8->delay_timer;
+    default:
+        return chip8->sound_timer;
+    }
+}
+
+static void gdb_reg_write(chip8_t *chip8, unsigned int reg, uint32_t value)
+{
+    if (reg < CHIP8_REGISTERS_SIZE) {
+        chip8->registers[reg] = value;
+        return;
+    }
+
+    switch (reg) {
+    case GDB_REG_I:
+        chip8->i_register = value;
+        break;
+    case GDB_REG_PC:
+        chip8->program_counter = value;
+        break;
+    case GDB_REG_SP:
+        chip8->stack_pointer = value;
+        break;
+    case GDB_REG_DT:
+        chip8->delay_timer = value;
+        break;
+    case GDB_REG_ST:
+        chip8->sound_timer = value;
+        break;
+    }
+}
+
+static void gdb_read_registers(gdb_t *gdb)
+{
+    char  reply[GDB_REG_COUNT * 4];
+    char *out = reply;
+
+    for (unsigned int reg = 0; reg < GDB_REG_COUNT; reg++) {
+        out = gdb_put_hex(out, gdb_reg_read(gdb->chip8, reg),
+                          gdb_reg_bytes(reg));
+    }
+
+    gdb_send(gdb, reply, out - reply);
+}
+
+static void gdb_write_registers(gdb_t *gdb, const char *in)
+{
+    for (unsigned int reg = 0; reg < GDB_REG_COUNT; reg++) {
+        int64_t value = gdb_get_hex(&in, gdb_reg_bytes(reg));
+
+        if (value < 0) {
+            gdb_send_str(gdb, "E01");
+            return;
+        }
+        gdb_reg_write(gdb->chip8, reg, value);
+    }
+
+    gdb_send_str(gdb, "OK");
+}
+
+static void gdb_read_register(gdb_t *gdb, const char *in)
+{
+    char          reply[8];
+    char         *out = reply;
+    unsigned long reg = strtoul(in, NULL, 16);
+
+    if (reg >= GDB_REG_COUNT) {
+        gdb_send_str(gdb, "E01");
+        return;
+    }
+
+    out = gdb_put_hex(out, gdb_reg_read(gdb->chip8, reg), gdb_reg_bytes(reg));
+    gdb_send(gdb, reply, out - reply);
+}
+
+static void gdb_write_register(gdb_t *gdb, const char *in)
+{
+    char         *end;
+    unsigned long reg = strtoul(in, &end, 16);
+    int64_t       value;
+
+    if (reg >= GDB_REG_COUNT || *end != '=') {
+        gdb_send_str(gdb, "E01");
+        return;
+    }
+
+    in    = end + 1;
+    value = gdb_get_hex(&in, gdb_reg_bytes(reg));
+    if (value < 0) {
+        gdb_send_str(gdb, "E01");
+        return;
+    }
+
+    gdb_reg_write(gdb->chip8, reg, value);
+    gdb_send_str(gdb, "OK");
+}
+
+/* "addr,length", bounded by the address space of the current mode */
+static bool gdb_parse_range(const chip8_t *chip8, const char **in,
+                            uint32_t *address, uint32_t *length)
+{
+    char *end;
+
+    *address = strtoul(*in, &end, 16);
+    if (*end != ',') {
+        return false;
+    }
+    *length = strtoul(end + 1, &end, 16);
+    *in     = end;
+
+    return *address <= chip8->memory_mask &&
+           *length <= chip8->memory_mask + 1u - *address;
+}
+
+static void gdb_read_memory(gdb_t *gdb, const char *in)
+{
+    char     reply[GDB_PACKET_SIZE];
+    char    *out = reply;
+    uint32_t address;
+    uint32_t length;
+
+    if (!gdb_parse_range(gdb->chip8, &in, &address, &length)) {
+        gdb_send_str(gdb, "E01");
+        return;
+    }
+
+    if (length > GDB_PACKET_SIZE / 2) {
+        length = GDB_PACKET_SIZE / 2;
+    }
+    for (uint32_t i = 0; i < length; i++) {
+        out = gdb_put_hex(out, gdb->chip8->memory[address + i], 1);
+    }
+
+    gdb_send(gdb, reply, out - reply);
+}
+
+/**
+ * A debugger poking code behaves like a guest store: the lines it hits
+ * are invalidated so no engine keeps running the old instructions.
+ */
+static void gdb_write_memory(gdb_t *gdb, const char *in)
+{
+    uint32_t address;
+    uint32_t length;
+
+    if (!gdb_parse_range(gdb->chip8, &in, &address, &length) || *in != ':') {
+        gdb_send_str(gdb, "E01");
+        return;
+    }
+
+    in++;
+    for (uint32_t i = 0; i < length; i++) {
+        int64_t value = gdb_get_hex(&in, 1);
+
+        if (value < 0) {
+            gdb_send_str(gdb, "E01");
+            return;
+        }
+        gdb->chip8->memory[address + i] = value;
+    }
+
+    for (uint32_t i = 0; i < length; i += GDB_LINE_SIZE) {
+        chip8_code_written(gdb->chip8, address + i,
+                           length - i < GDB_LINE_SIZE ? length - i
+                                                      : GDB_LINE_SIZE);
+    }
+
+    gdb_send_str(gdb, "OK");
+}
+
+/* Z/z type,addr,kind */
+static void gdb_point(gdb_t *gdb, const char *in, bool insert)
+{
+    chip8_debug_kind_t kind;
+    char              *end;
+    unsigned long      type    = strtoul(in, &end, 16);
+    unsigned long      address = 0;
+    unsigned long      length  = 1;
+    int                err;
+
+    if (*end == ',') {
+        address = strtoul(end + 1, &end, 16);
+    }
+    if (*end == ',') {
+        length = strtoul(end + 1, &end, 16);
+    }
+
+    if (type == GDB_Z_SOFTWARE || type == GDB_Z_HARDWARE) {
+        kind = CHIP8_DEBUG_BREAK;
+    } else if (type == GDB_Z_WRITE) {
+        kind = CHIP8_DEBUG_WATCH;
+    } else {
+        gdb_send_str(gdb, "");
+        return;
+    }
+
+    if (insert) {
+        err = chip8_debug_add(&gdb->debug, kind, address, length, NULL);
+    } else {
+        err = chip8_debug_remove(&gdb->debug, kind, address);
+    }
+
+    gdb_send_str(gdb, err == CHIP8_OK ? "OK" : "E01");
+}
+
+static void gdb_read_features(gdb_t *gdb, const char *in)
+{
+    char          reply[GDB_PACKET_SIZE];
+    size_t        size = sizeof(gdb_target_xml) - 1;
+    unsigned long offset;
+    unsigned long length;
+    char         *end;
+
+    if (strncmp(in, "target.xml:", 11) != 0) {
+        gdb_send_str(gdb, "E00");
+        return;
+    }
+
+    offset = strtoul(in + 11, &end, 16);
+    length = *end == ',' ? strtoul(end + 1, NULL, 16) : 0;
+    if (offset > size) {
+        gdb_send_str(gdb, "E01");
+        return;
+    }
+    if (length > size - offset) {
+        length = size - offset;
+    }
+    if (length > sizeof(reply) - 1) {
+        length = sizeof(reply) - 1;
+    }
+
+    reply[0] = offset + length < size ? 'm' : 'l';
+    memcpy(&reply[1], &gdb_target_xml[offset], length);
+    gdb_send(gdb, reply, length + 1);
+}
+
+static void gdb_query(gdb_t *gdb, const char *in)
+{
+    if (strncmp(in, "qSupported", 10) == 0) {
+        gdb_send_str(gdb, "PacketSize=1000;qXfer:features:read+;"
+                          "QStartNoAckMode+");
+    } else if (strncmp(in, "qXfer:features:read:", 20) == 0) {
+        gdb_read_features(gdb, in + 20);
+    } else if (strcmp(in, "qAttached") == 0) {
+        gdb_send_str(gdb, "1");
+    } else if (strcmp(in, "qC") == 0) {
+        gdb_send_str(gdb, "QC1");
+    } else if (strcmp(in, "qfThreadInfo") == 0) {
+        gdb_send_str(gdb, "m1");
+    } else if (strcmp(in, "qsThreadInfo") == 0) {
+        gdb_send_str(gdb, "l");
+    } else if (strcmp(in, "QStartNoAckMode") == 0) {
+        gdb_send_str(gdb, "OK");
+        gdb->noack = true;
+    } else {
+        gdb_send_str(gdb, "");
+    }
+}
+
+/* c/s with an optional resume address */
+static void gdb_continue(gdb_t *gdb, const char *in, gdb_resume_t resume)
+{
+    if (*in) {
+        gdb->chip8->program_counter = strtoul(in, NULL, 16);
+    }
+
+    gdb->running = true;
+    gdb_resume(gdb, resume);
+}
+
+/**
+ * Handle one packet. In all-stop mode the debugger only sends packets
+ * while the target is stopped, the halt below only matters for a client
+ * that does not wait for the stop reply.
+ */
+static void gdb_handle(gdb_t *gdb, char *in)
+{
+    if (!gdb_halt(gdb)) {
+        return;
+    }
+
+    switch (in[0]) {
+    case '?':
+        gdb_send_stop(gdb);
+        break;
+    case 'g':
+        gdb_read_registers(gdb);
+        break;
+    case 'G':
+        gdb_write_registers(gdb, in + 1);
+        break;
+    case 'p':
+        gdb_read_register(gdb, in + 1);
+        break;
+    case 'P':
+        gdb_write_register(gdb, in + 1);
+        break;
+    case 'm':
+        gdb_read_memory(gdb, in + 1);
+        break;
+    case 'M':
+        gdb_write_memory(gdb, in + 1);
+        break;
+    case 'Z':
+    case 'z':
+        gdb_point(gdb, in + 1, in[0] == 'Z');
+        break;
+    case 'c':
+        gdb_continue(gdb, in + 1, GDB_RESUME_CONTINUE);
+        break;
+    case 's':
+        gdb_continue(gdb, in + 1, GDB_RESUME_STEP);
+        break;
+    case 'H':
+        gdb_send_str(gdb, "OK");
+        break;
+    case 'q':
+    case 'Q':
+        gdb_query(gdb, in);
+        break;
+    case 'D':
+        gdb_send_str(gdb, "OK");
+        gdb->detach = true;
+        break;
+    case 'k':
+        gdb->detach = true;
+        if (gdb->kill) {
+            gdb->kill(gdb->kill_ctx);
+        }
+        break;
+    default:
+        gdb_send_str(gdb, "");
+        break;
+    }
+}
+
+/* feed received bytes through the packet framing */
+static void gdb_receive(gdb_t *gdb, const char *data, size_t length)
+{
+    for (size_t i = 0; i < length && !gdb->detach; i++) {
+        char c = data[i];
+
+        switch (gdb->rx_state) {
+        case GDB_RX_IDLE:
+            if (c == '$') {
+                gdb->rx_state = GDB_RX_DATA;
+                gdb->length   = 0;
+            } else if (c == 0x03) {
+                /* ^C: the cpu thread stops at its next batch boundary */
+                pthread_mutex_lock(&gdb->lock);
+                gdb->interrupt = true;
+                pthread_mutex_unlock(&gdb->lock);
+                atomic_store_explicit(&gdb->halt, true, memory_order_release);
+            }
+            break;
+        case GDB_RX_DATA:
+            if (c == '#') {
+                gdb->rx_state    = GDB_RX_CHECKSUM;
+                gdb->rx_checksum = 0;
+            } else if (gdb->length < GDB_PACKET_SIZE - 1) {
+                gdb->packet[gdb->length++] = c;
+            }
+            break;
+        default:
+            /* the checksum is not checked, a local socket does not corrupt */
+            if (++gdb->rx_checksum < 2) {
+                break;
+            }
+            gdb->rx_state              = GDB_RX_IDLE;
+            gdb->packet[gdb->length] = '\0';
+            if (!gdb->noack) {
+                (void)!write(gdb->client_fd, "+", 1);
+            }
+            gdb_handle(gdb, gdb->packet);
+            break;
+        }
+    }
+}
+
+/* the cpu thread stopped on its own or after a step, tell the debugger */
+static void gdb_stopped(gdb_t *gdb)
+{
+    bool halted;
+
+    pthread_mutex_lock(&gdb->lock);
+    halted = gdb->halted;
+    pthread_mutex_unlock(&gdb->lock);
+
+    if (halted && gdb->running) {
+        gdb->running = false;
+        gdb_send_stop(gdb);
+    }
+}
+
+static void gdb_session(gdb_t *gdb)
+{
+    struct pollfd fds[2] = {
+        { .fd = gdb->client_fd, .events = POLLIN },
+        { .fd = gdb->wake_fd, .events = POLLIN },
+    };
+    char     data[GDB_PACKET_SIZE];
+    uint64_t value;
+    ssize_t  length;
+
+    gdb->rx_state = GDB_RX_IDLE;
+    gdb->noack    = false;
+    gdb->detach   = false;
+    gdb->running  = false;
+
+    while (!gdb->detach &&
+           !atomic_load_explicit(&gdb->shutdown, memory_order_acquire)) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            (void)!read(gdb->wake_fd, &value, sizeof(value));
+            gdb_stopped(gdb);
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            length = read(gdb->client_fd, data, sizeof(data));
+            if (length <= 0) {
+                break;
+            }
+            gdb_receive(gdb, data, length);
+        }
+    }
+
+    /* leave the machine running as if no debugger had been there */
+    if (gdb_halt(gdb)) {
+        chip8_debug_cleanup(&gdb->debug);
+        chip8_debug_init(&gdb->debug, gdb->chip8);
+        gdb_resume(gdb, GDB_RESUME_CONTINUE);
+    }
+}
+
+static void *gdb_thread(void *arg)
+{
+    gdb_t        *gdb     = arg;
+    struct pollfd fds[2] = {
+        { .fd = gdb->listen_fd, .events = POLLIN },
+        { .fd = gdb->wake_fd, .events = POLLIN },
+    };
+    uint64_t      value;
+
+    while (!atomic_load_explicit(&gdb->shutdown, memory_order_acquire)) {
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+            break;
+        }
+
+        /* only a shutdown matters here, stops are reported in a session */
+        if (fds[1].revents & POLLIN) {
+            (void)!read(gdb->wake_fd, &value, sizeof(value));
+        }
+
+        if (fds[0].revents & POLLIN) {
+            gdb->client_fd = accept(gdb->listen_fd, NULL, NULL);
+            if (gdb->client_fd >= 0) {
+                gdb_session(gdb);
+                close(gdb->client_fd);
+                gdb->client_fd = -1;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void gdb_shutdown(gdb_t *gdb)
+{
+    if (!gdb->chip8) {
+        return;
+    }
+
+    atomic_store_explicit(&gdb->shutdown, true, memory_order_release);
+
+    pthread_mutex_lock(&gdb->lock);
+    pthread_cond_broadcast(&gdb->cond);
+    pthread_mutex_unlock(&gdb->lock);
+
+    if (gdb->wake_fd >= 0) {
+        gdb_wake(gdb);
+    }
+}
+
+void gdb_cleanup(gdb_t *gdb)
+{
+    if (!gdb->chip8) {
+        return;
+    }
+
+    gdb_shutdown(gdb);
+    if (gdb->started) {
+        pthread_join(gdb->thread, NULL);
+        gdb->started = false;
+    }
+
+    chip8_debug_cleanup(&gdb->debug);
+
+    if (gdb->listen_fd >= 0) {
+        close(gdb->listen_fd);
+    }
+    if (gdb->wake_fd >= 0) {
+        close(gdb->wake_fd);
+    }
+    pthread_cond_destroy(&gdb->cond);
+    pthread_mutex_destroy(&gdb->lock);
+
+    gdb->chip8 = NULL;
+}
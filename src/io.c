@@ -1,4 +1,17 @@
 #include "io.h"
+#include "chip8_display.h"
+
+/**
+ * Colour of each pixel, indexed by the bits it has set in planes 0-3.
+ * Entries 0 and 1 keep the classic black and white look for single-plane
+ * ROMs, the rest follow the usual XO-CHIP four-plane palette.
+ */
+static const uint32_t io_palette[1 << CHIP8_PLANES] = {
+    0xFF000000, 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555,
+    0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0xFFFFFF00,
+    0xFF880000, 0xFF008800, 0xFF000088, 0xFF888800,
+    0xFFFF00FF, 0xFF00FFFF, 0xFF880088, 0xFF008888,
+};
 
 static int io_cycle(io_t *io);
 
@@ -20,30 +33,146 @@ int io_init(io_t *io, int width, int height)
         return IO_WINDOW_CREATE_ERROR;
     }
 
+    io->renderer = SDL_CreateRenderer(io->window, -1, SDL_RENDERER_ACCELERATED);
+    if (io->renderer == NULL) {
+        return IO_RENDERER_CREATE_ERROR;
+    }
+
+    io->texture = SDL_CreateTexture(io->renderer, SDL_PIXELFORMAT_ARGB8888,
+                                    SDL_TEXTUREACCESS_STREAMING,
+                                    CHIP8_DISPLAY_WIDTH, CHIP8_DISPLAY_HEIGHT);
+    if (io->texture == NULL) {
+        return IO_RENDERER_CREATE_ERROR;
+    }
+
+    io->scale         = width / CHIP8_DISPLAY_WIDTH;
     io->cycle_handler = io_cycle;
 
     return IO_OK;
 }
 
+/* classic COSMAC VIP layout mapped onto the left side of a QWERTY keyboard */
+static uint8_t io_decode_key(SDL_Scancode scancode)
+{
+    switch (scancode) {
+    case SDL_SCANCODE_1:
+        return 0x1;
+    case SDL_SCANCODE_2:
+        return 0x2;
+    case SDL_SCANCODE_3:
+        return 0x3;
+    case SDL_SCANCODE_4:
+        return 0xC;
+    case SDL_SCANCODE_Q:
+        return 0x4;
+    case SDL_SCANCODE_W:
+        return 0x5;
+    case SDL_SCANCODE_E:
+        return 0x6;
+    case SDL_SCANCODE_R:
+        return 0xD;
+    case SDL_SCANCODE_A:
+        return 0x7;
+    case SDL_SCANCODE_S:
+        return 0x8;
+    case SDL_SCANCODE_D:
+        return 0x9;
+    case SDL_SCANCODE_F:
+        return 0xE;
+    case SDL_SCANCODE_Z:
+        return 0xA;
+    case SDL_SCANCODE_X:
+        return 0x0;
+    case SDL_SCANCODE_C:
+        return 0xB;
+    case SDL_SCANCODE_V:
+        return 0xF;
+    default:
+        return IO_KEY_NONE;
+    }
+}
+
+static void io_push_key(io_t *io, SDL_Scancode scancode,
+                        chip8_key_state_t state)
+{
+    uint8_t key = io_decode_key(scancode);
+
+    if (!io->chip8 || key == IO_KEY_NONE) {
+        return;
+    }
+
+    chip8_keypad_set(io->chip8, key, state);
+}
+
 static int io_cycle(io_t *io)
 {
     SDL_Event event;
-
-    (void)io;
+    int       result = IO_OK;
 
     while (SDL_PollEvent(&event)) {
-        if (event.type == SDL_QUIT) {
+        switch (event.type) {
+        case SDL_QUIT:
             return IO_QUIT;
+
+        case SDL_KEYDOWN:
+            if (event.key.repeat) {
+                break;
+            }
+
+            if (event.key.keysym.scancode == SDL_SCANCODE_TAB) {
+                result = IO_TURBO_TOGGLE;
+            } else {
+                io_push_key(io, event.key.keysym.scancode, CHIP8_KEY_PRESSED);
+            }
+            break;
+
+        case SDL_KEYUP:
+            io_push_key(io, event.key.keysym.scancode, CHIP8_KEY_IDLE);
+            break;
+
+        default:
+            break;
         }
+    }
+
+    return result;
+}
+
+void io_present(io_t *io, const frame_t *frame)
+{
+    uint32_t *pixels;
+    int       pitch;
 
-        SDL_Delay(1000);
+    if (SDL_LockTexture(io->texture, NULL, (void **)&pixels, &pitch) != 0) {
+        return;
     }
 
-    return IO_OK;
+    for (int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+        uint32_t *row = (uint32_t *)((uint8_t *)pixels + y * pitch);
+        for (int x = 0; x < CHIP8_DISPLAY_WIDTH; x++) {
+            unsigned int color = 0;
+
+            for (int plane = 0; plane < CHIP8_PLANES; plane++) {
+                color |= chip8_display_pixel(frame->planes[plane], x, y)
+                         << plane;
+            }
+            row[x] = io_palette[color];
+        }
+    }
+
+    SDL_UnlockTexture(io->texture);
+    SDL_RenderCopy(io->renderer, io->texture, NULL, NULL);
+    SDL_RenderPresent(io->renderer);
 }
 
 void io_cleanup(io_t *io)
 {
+    if (io->texture) {
+        SDL_DestroyTexture(io->texture);
+    }
+    if (io->renderer) {
+        SDL_DestroyRenderer(io->renderer);
+    }
     SDL_DestroyWindow(io->window);
     SDL_Quit();
 }
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmocka.h>
+
+#include "chip8.h"
+#include "chip8_code.h"
+#include "chip8_decode.h"
+
+/**
+ * Stores the second half of the ROM's code into 0x300 and jumps there,
+ * but only while key 5 is held:
+ *
+ *   200  A300  I = 300
+ *   202  6063  V0 = 63
+ *   204  6177  V1 = 77
+ *   206  6205  V2 = 5
+ *   208  E29E  skip if key V2 is down
+ *   20A  120E  jump 20E
+ *   20C  F155  store V0..V1 at I, 300: 6377 (V3 = 77)
+ *   20E  1300  jump 300
+ */
+static const uint8_t test_chip8_patch_rom[] = {
+    0xA3, 0x00, 0x60, 0x63, 0x61, 0x77, 0x62, 0x05,
+    0xE2, 0x9E, 0x12, 0x0E, 0xF1, 0x55, 0x13, 0x00,
+};
+
+static unsigned int test_chip8_invalidations;
+
+static void test_chip8_invalidate(void *ctx, uint16_t address, uint32_t len)
+{
+    (void)ctx;
+    (void)address;
+    (void)len;
+
+    test_chip8_invalidations++;
+}
+
+static int test_chip8_load(chip8_t *chip8, const uint8_t *rom, size_t size)
+{
+    char path[] = "/tmp/test_chip8_XXXXXX";
+    int  fd     = mkstemp(path);
+    int  err;
+
+    assert_true(fd >= 0);
+    assert_int_equal(write(fd, rom, size), size);
+    close(fd);
+
+    err = chip8_init(chip8, path, CHIP8_MODE_CHIP8);
+    unlink(path);
+
+    return err;
+}
+
+static void test_chip8_load_state_code_generation(void **state)
+{
+    static chip8_t          chip8;
+    static chip8_snapshot_t snapshot;
+
+    assert_int_equal(test_chip8_load(&chip8, test_chip8_patch_rom,
+                                     sizeof(test_chip8_patch_rom)),
+                     CHIP8_OK);
+    assert_int_equal(chip8_code_watch(&chip8, test_chip8_invalidate, NULL),
+                     CHIP8_OK);
+
+    chip8_code_mark(&chip8, 0x300, 2);
+    chip8_save_state(&chip8, &snapshot);
+    chip8_code_written(&chip8, 0x300, 2);
+
+    test_chip8_invalidations = 0;
+    chip8_load_state(&chip8, &snapshot);
+
+    assert_int_equal(test_chip8_invalidations, 1);
+    assert_true(!chip8_code_test(&chip8, CHIP8_CODE_LINE(&chip8, 0x300)));
+}
+
+/* code decoded after the snapshot was taken must not survive a restore */
+static void test_chip8_load_state_code_marks(void **state)
+{
+    static chip8_t          chip8;
+    static chip8_snapshot_t snapshot;
+
+    assert_int_equal(test_chip8_load(&chip8, test_chip8_patch_rom,
+                                     sizeof(test_chip8_patch_rom)),
+                     CHIP8_OK);
+    assert_int_equal(chip8_code_watch(&chip8, test_chip8_invalidate, NULL),
+                     CHIP8_OK);
+
+    chip8_save_state(&chip8, &snapshot);
+    chip8_code_mark(&chip8, 0x300, 2);
+
+    test_chip8_invalidations = 0;
+    chip8_load_state(&chip8, &snapshot);
+
+    assert_int_equal(test_chip8_invalidations, 1);
+    assert_true(!chip8_code_test(&chip8, CHIP8_CODE_LINE(&chip8, 0x300)));
+
+    /* nothing marked or written since: the restore keeps every mark */
+    chip8_code_mark(&chip8, 0x300, 2);
+    chip8_save_state(&chip8, &snapshot);
+
+    test_chip8_invalidations = 0;
+    chip8_load_state(&chip8, &snapshot);
+
+    assert_int_equal(test_chip8_invalidations, 0);
+    assert_true(chip8_code_test(&chip8, CHIP8_CODE_LINE(&chip8, 0x300)));
+}
+
+/* a run-ahead style rollback over a store the decoder then ran */
+static void test_chip8_load_state_decoder_rollback(void **state)
+{
+    static chip8_t          chip8;
+    static chip8_decoder_t  decoder;
+    static chip8_snapshot_t snapshot;
+
+    assert_int_equal(test_chip8_load(&chip8, test_chip8_patch_rom,
+                                     sizeof(test_chip8_patch_rom)),
+                     CHIP8_OK);
+    assert_int_equal(chip8_decoder_init(&decoder, &chip8, CHIP8_FUSE_ALL),
+                     CHIP8_OK);
+
+    chip8_save_state(&chip8, &snapshot);
+    chip8_keypad_set(&chip8, 5, CHIP8_KEY_PRESSED);
+    chip8_run(&chip8, 9, NULL);
+    assert_int_equal(chip8.registers[3], 0x77);
+
+    chip8_load_state(&chip8, &snapshot);
+    chip8_keypad_set(&chip8, 5, CHIP8_KEY_IDLE);
+    chip8_run(&chip8, 8, NULL);
+
+    assert_int_equal(chip8.memory[0x300], 0);
+    assert_int_equal(chip8.registers[3], 0);
+
+    chip8_decoder_cleanup(&decoder);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_chip8_load_state_code_generation),
+        cmocka_unit_test(test_chip8_load_state_code_marks),
+        cmocka_unit_test(test_chip8_load_state_decoder_rollback),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
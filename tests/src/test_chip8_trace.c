@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "chip8_trace.h"
+
+#define TEST_CHIP8_TRACE_SIZE  (CHIP8_TRACE_CHUNK * sizeof(chip8_trace_record_t))
+#define TEST_CHIP8_TRACE_GUARD (64)
+#define TEST_CHIP8_TRACE_FILL  (0xA5)
+
+static uint8_t test_src[TEST_CHIP8_TRACE_SIZE];
+static uint8_t test_packed[CHIP8_TRACE_PACK_BOUND(TEST_CHIP8_TRACE_SIZE)];
+static uint8_t test_dst[TEST_CHIP8_TRACE_SIZE + TEST_CHIP8_TRACE_GUARD];
+
+static uint32_t test_random(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+
+    return *state;
+}
+
+/* packs `len` bytes of test_src and checks they unpack to the same bytes */
+static void test_chip8_trace_round_trip(size_t len)
+{
+    size_t packed = chip8_trace_pack(test_src, len, test_packed);
+    long   size;
+
+    assert_true(packed <= CHIP8_TRACE_PACK_BOUND(len));
+
+    memset(test_dst, TEST_CHIP8_TRACE_FILL, sizeof(test_dst));
+    size = chip8_trace_unpack(test_packed, packed, test_dst, len);
+
+    assert_int_equal(size, len);
+    assert_true(memcmp(test_src, test_dst, len) == 0);
+    assert_int_equal(test_dst[len], TEST_CHIP8_TRACE_FILL);
+}
+
+static const size_t test_lengths[] = {
+    0, 1, 3, 4, 5, 15, 16, 19, 20, 255, 270, 271, 1000, TEST_CHIP8_TRACE_SIZE,
+};
+
+#define TEST_CHIP8_TRACE_LENGTHS (sizeof(test_lengths) / sizeof(test_lengths[0]))
+
+static void test_chip8_trace_pack_zeros(void **state)
+{
+    memset(test_src, 0, sizeof(test_src));
+
+    for (size_t i = 0; i < TEST_CHIP8_TRACE_LENGTHS; i++) {
+        test_chip8_trace_round_trip(test_lengths[i]);
+    }
+
+    /* one long match, far below the raw size */
+    assert_true(chip8_trace_pack(test_src, sizeof(test_src), test_packed) <
+                sizeof(test_src) / 64);
+}
+
+static void test_chip8_trace_pack_random(void **state)
+{
+    uint32_t seed = 0x2545F491;
+
+    for (size_t i = 0; i < sizeof(test_src); i++) {
+        test_src[i] = test_random(&seed);
+    }
+
+    for (size_t i = 0; i < TEST_CHIP8_TRACE_LENGTHS; i++) {
+        test_chip8_trace_round_trip(test_lengths[i]);
+    }
+}
+
+/* short runs and repeats of every length, to hit each length encoding */
+static void test_chip8_trace_pack_mixed(void **state)
+{
+    uint32_t seed = 0x9E3779B9;
+    size_t   at   = 0;
+    size_t   run;
+
+    while (at < sizeof(test_src)) {
+        run = test_random(&seed) % 600 + 1;
+        if (run > sizeof(test_src) - at) {
+            run = sizeof(test_src) - at;
+        }
+
+        if (at >= 16 && test_random(&seed) & 1) {
+            size_t offset = test_random(&seed) % (at < 70000 ? at : 70000) + 1;
+
+            for (size_t i = 0; i < run; i++, at++) {
+                test_src[at] = test_src[at - offset];
+            }
+        } else {
+            for (size_t i = 0; i < run; i++, at++) {
+                test_src[at] = test_random(&seed);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < TEST_CHIP8_TRACE_LENGTHS; i++) {
+        test_chip8_trace_round_trip(test_lengths[i]);
+    }
+}
+
+/* a frame as the writer packs it, from records of a small loop */
+static void test_chip8_trace_pack_records(void **state)
+{
+    chip8_trace_record_t *records = (chip8_trace_record_t *)test_src;
+    uint8_t               raw[TEST_CHIP8_TRACE_SIZE];
+
+    memset(test_src, 0, sizeof(test_src));
+    for (uint32_t i = 0; i < CHIP8_TRACE_CHUNK; i++) {
+        records[i].cycle      = i;
+        records[i].pc         = 0x200 + (i % 3) * 2;
+        records[i].opcode     = 0x7001 + (i % 3);
+        records[i].i_register = 0x300;
+        records[i].x          = 0;
+        records[i].vx         = i / 3;
+    }
+    memcpy(raw, test_src, sizeof(raw));
+
+    chip8_trace_delta(test_src, CHIP8_TRACE_CHUNK);
+    test_chip8_trace_round_trip(sizeof(test_src));
+
+    chip8_trace_undelta(test_dst, CHIP8_TRACE_CHUNK);
+    assert_true(memcmp(test_dst, raw, sizeof(raw)) == 0);
+}
+
+static void test_chip8_trace_unpack_truncated(void **state)
+{
+    uint32_t seed = 0x2545F491;
+    size_t   packed;
+    long     size;
+
+    for (size_t i = 0; i < 2000; i++) {
+        test_src[i] = i % 7 == 0 ? test_random(&seed) : i % 50;
+    }
+    packed = chip8_trace_pack(test_src, 2000, test_packed);
+
+    /* every prefix either fails or unpacks to a prefix of the input */
+    for (size_t len = 0; len < packed; len++) {
+        memset(test_dst, TEST_CHIP8_TRACE_FILL, sizeof(test_dst));
+        size = chip8_trace_unpack(test_packed, len, test_dst, 2000);
+
+        assert_true(size <= 2000);
+        if (size > 0) {
+            assert_true(memcmp(test_src, test_dst, size) == 0);
+        }
+        assert_int_equal(test_dst[2000], TEST_CHIP8_TRACE_FILL);
+    }
+
+    /* and a destination one byte short never gets written past */
+    memset(test_dst, TEST_CHIP8_TRACE_FILL, sizeof(test_dst));
+    assert_int_equal(chip8_trace_unpack(test_packed, packed, test_dst, 1999),
+                     -1);
+    assert_int_equal(test_dst[1999], TEST_CHIP8_TRACE_FILL);
+}
+
+static void test_chip8_trace_unpack_corrupt(void **state)
+{
+    /* a match before any output */
+    static const uint8_t no_history[] = { 0x00, 0x01, 0x00 };
+    /* a zero offset */
+    static const uint8_t zero_offset[] = { 0x10, 'a', 0x00, 0x00 };
+    /* an offset past the start of the output */
+    static const uint8_t far_offset[] = { 0x20, 'a', 'b', 0x03, 0x00 };
+    /* more literals than the input holds */
+    static const uint8_t short_literals[] = { 0x50, 'a', 'b' };
+    /* a length extension cut off */
+    static const uint8_t short_length[] = { 0xF0, 0xFF };
+    /* an offset cut off */
+    static const uint8_t short_offset[] = { 0x10, 'a', 0x01 };
+    uint32_t             seed = 0x2545F491;
+    long                 size;
+
+    assert_int_equal(chip8_trace_unpack(no_history, sizeof(no_history),
+                                        test_dst, 64),
+                     -1);
+    assert_int_equal(chip8_trace_unpack(zero_offset, sizeof(zero_offset),
+                                        test_dst, 64),
+                     -1);
+    assert_int_equal(chip8_trace_unpack(far_offset, sizeof(far_offset),
+                                        test_dst, 64),
+                     -1);
+    assert_int_equal(chip8_trace_unpack(short_literals,
+                                        sizeof(short_literals), test_dst, 64),
+                     -1);
+    assert_int_equal(chip8_trace_unpack(short_length, sizeof(short_length),
+                                        test_dst, 64),
+                     -1);
+    assert_int_equal(chip8_trace_unpack(short_offset, sizeof(short_offset),
+                                        test_dst, 64),
+                     -1);
+
+    /* random bytes never write past the destination */
+    for (unsigned int i = 0; i < 10000; i++) {
+        size_t len = test_random(&seed) % 64 + 1;
+
+        for (size_t j = 0; j < len; j++) {
+            test_packed[j] = test_random(&seed);
+        }
+
+        memset(test_dst, TEST_CHIP8_TRACE_FILL, sizeof(test_dst));
+        size = chip8_trace_unpack(test_packed, len, test_dst, 256);
+
+        assert_true(size >= -1 && size <= 256);
+        assert_int_equal(test_dst[256], TEST_CHIP8_TRACE_FILL);
+    }
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_chip8_trace_pack_zeros),
+        cmocka_unit_test(test_chip8_trace_pack_random),
+        cmocka_unit_test(test_chip8_trace_pack_mixed),
+        cmocka_unit_test(test_chip8_trace_pack_records),
+        cmocka_unit_test(test_chip8_trace_unpack_truncated),
+        cmocka_unit_test(test_chip8_trace_unpack_corrupt),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmocka.h>
+
+#include "chip8.h"
+#include "chip8_watchdog.h"
+
+#define TEST_CHIP8_FRAME  (11) /* instructions, as the emulator runs them */
+#define TEST_CHIP8_CHECKS (8)
+
+/* 200  1200  jump 200 */
+static const uint8_t test_chip8_spin_rom[] = { 0x12, 0x00 };
+
+/**
+ * A title screen: loops until key 0 is pressed.
+ *
+ *   200  E0A1  skip if key V0 is up
+ *   202  1206  jump 206
+ *   204  1200  jump 200
+ *   206  1206  jump 206
+ */
+static const uint8_t test_chip8_poll_rom[] = {
+    0xE0, 0xA1, 0x12, 0x06, 0x12, 0x00, 0x12, 0x06,
+};
+
+/* 200  F00A  wait for a key */
+static const uint8_t test_chip8_wait_rom[] = { 0xF0, 0x0A };
+
+static int test_chip8_load(chip8_t *chip8, const uint8_t *rom, size_t size)
+{
+    char path[] = "/tmp/test_chip8_XXXXXX";
+    int  fd     = mkstemp(path);
+    int  err;
+
+    assert_true(fd >= 0);
+    assert_int_equal(write(fd, rom, size), size);
+    close(fd);
+
+    err = chip8_init(chip8, path, CHIP8_MODE_CHIP8);
+    unlink(path);
+
+    return err;
+}
+
+/* runs a frame per check, returns the first check that did not pass */
+static int test_chip8_watch(const uint8_t *rom, size_t size)
+{
+    static chip8_t          chip8;
+    static chip8_watchdog_t watchdog;
+    int                     err;
+
+    assert_int_equal(test_chip8_load(&chip8, rom, size), CHIP8_OK);
+    assert_int_equal(chip8_watchdog_init(&watchdog, &chip8), CHIP8_OK);
+
+    for (int i = 0; i < TEST_CHIP8_CHECKS; i++) {
+        err = chip8_run(&chip8, TEST_CHIP8_FRAME, NULL);
+        assert_true(err == CHIP8_OK || err == CHIP8_KEY_WAIT);
+
+        err = chip8_watchdog_check(&watchdog);
+        if (err != CHIP8_OK) {
+            return err;
+        }
+    }
+
+    return CHIP8_OK;
+}
+
+static void test_chip8_watchdog_spin(void **state)
+{
+    assert_int_equal(test_chip8_watch(test_chip8_spin_rom,
+                                      sizeof(test_chip8_spin_rom)),
+                     CHIP8_STUCK);
+}
+
+static void test_chip8_watchdog_key_poll(void **state)
+{
+    assert_int_equal(test_chip8_watch(test_chip8_poll_rom,
+                                      sizeof(test_chip8_poll_rom)),
+                     CHIP8_OK);
+}
+
+static void test_chip8_watchdog_key_wait(void **state)
+{
+    assert_int_equal(test_chip8_watch(test_chip8_wait_rom,
+                                      sizeof(test_chip8_wait_rom)),
+                     CHIP8_OK);
+}
+
+int main(void)
+{
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_chip8_watchdog_spin),
+        cmocka_unit_test(test_chip8_watchdog_key_poll),
+        cmocka_unit_test(test_chip8_watchdog_key_wait),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
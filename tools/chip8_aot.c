@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "chip8_aot.h"
+
+/**
+ * chip8-aot: compile a ROM ahead of time into a module chip8_aot_init()
+ * can load.
+ *
+ * Starting at the ROM entry point, every reachable address starts a basic
+ * block that runs until the first instruction that changes control flow
+ * or stores to memory (so a block never runs over code it rewrote itself),
+ * or until CHIP8_AOT_MAX_BLOCK instructions. Register arithmetic, loads
+ * and direct jumps are emitted as C; everything else calls back into the
+ * interpreter's handler with the program counter set up, so the generated
+ * code shares every quirk with chip8_interpret().
+ */
+
+#ifndef CHIP8_AOT_INCLUDE_DIR
+#define CHIP8_AOT_INCLUDE_DIR "include"
+#endif
+
+#define AOT_ENDS  (0x1) /* last instruction of a block */
+#define AOT_CALL  (0x2) /* run through the interpreter's handler */
+#define AOT_FLOWS (0x4) /* execution may continue at the next address */
+
+typedef struct
+{
+    chip8_t  chip8;
+    FILE    *out;
+    uint8_t  queued[CHIP8_MEMORY_SIZE];
+    uint16_t worklist[CHIP8_MEMORY_SIZE];
+    uint32_t pending;
+    uint32_t limit; /* end of the ROM image, nothing past it is compiled */
+
+    chip8_aot_block_t blocks[CHIP8_MEMORY_SIZE];
+    uint32_t          count;
+    uint32_t          code;
+} aot_compiler_t;
+
+static aot_compiler_t compiler;
+
+static uint16_t aot_word(const chip8_t *chip8, uint32_t address)
+{
+    return (CHIP8_MEM(chip8, address) << 8) | CHIP8_MEM(chip8, address + 1);
+}
+
+static void aot_queue(aot_compiler_t *c, uint32_t address)
+{
+    if (address < CHIP8_ROM_START || address + 2 > c->limit ||
+        c->queued[address]) {
+        return;
+    }
+
+    c->queued[address]        = 1;
+    c->worklist[c->pending++] = address;
+}
+
+/**
+ * Classify the instruction at `address`, queueing every successor the
+ * walk can know about. Returns the AOT_* flags and its size in bytes.
+ */
+static int aot_classify(aot_compiler_t *c, uint32_t address, uint16_t command,
+                        unsigned int *size)
+{
+    const chip8_t *chip8 = &c->chip8;
+    uint8_t        low   = command & 0xFF;
+    uint32_t       skip  = address + 4;
+
+    *size = 2;
+
+    if (chip8->mode == CHIP8_MODE_XOCHIP &&
+        aot_word(chip8, address + 2) == CHIP8_LONG_LOAD) {
+        skip = address + 6;
+    }
+
+    switch (CHIP8_NIBBLE(command, 4)) {
+    case 0x0:
+        if (command == 0x00EE) {
+            return AOT_CALL | AOT_ENDS;
+        }
+        if (command == 0x00E0 || (command & 0xFFE0) == 0x00C0 ||
+            command == 0x00FB || command == 0x00FC || command == 0x00FE ||
+            command == 0x00FF) {
+            return AOT_CALL | AOT_FLOWS;
+        }
+        /* 0nnn and anything unknown: let the interpreter report it */
+        return AOT_CALL | AOT_ENDS;
+
+    case 0x1:
+        aot_queue(c, command & CHIP8_LSB_MASK(3));
+        return AOT_ENDS;
+
+    case 0x2:
+        aot_queue(c, command & CHIP8_LSB_MASK(3));
+        aot_queue(c, address + 2);
+        return AOT_CALL | AOT_ENDS;
+
+    case 0x5:
+        if ((command & 0xF) == 0x2) {
+            /* XO-CHIP store, may rewrite code right after it */
+            aot_queue(c, address + 2);
+            return AOT_CALL | AOT_ENDS;
+        }
+        if ((command & 0xF) == 0x3) {
+            return AOT_CALL | AOT_FLOWS;
+        }
+        /* fall through */
+    case 0x3:
+    case 0x4:
+    case 0x9:
+        aot_queue(c, address + 2);
+        aot_queue(c, skip);
+        return AOT_CALL | AOT_ENDS;
+
+    case 0x6:
+    case 0x7:
+    case 0x8:
+    case 0xA:
+        return AOT_FLOWS;
+
+    case 0xB:
+        /* indirect, the target is left to the interpreter */
+        return AOT_CALL | AOT_ENDS;
+
+    case 0xE:
+        aot_queue(c, address + 2);
+        aot_queue(c, skip);
+        return AOT_CALL | AOT_ENDS;
+
+    case 0xF:
+        if (command == CHIP8_LONG_LOAD && chip8->mode == CHIP8_MODE_XOCHIP) {
+            *size = 4;
+            aot_queue(c, address + 4);
+            return AOT_CALL | AOT_ENDS;
+        }
+        if (low == 0x0A || low == 0x33 || low == 0x55) {
+            aot_queue(c, address + 2);
+            return AOT_CALL | AOT_ENDS;
+        }
+        return AOT_CALL | AOT_FLOWS;
+
+    default:
+        return AOT_CALL | AOT_FLOWS;
+    }
+}
+
+/* mirrors chip8_decode_handler_msb_8, statement for statement */
+static void aot_emit_alu(FILE *out, uint16_t command)
+{
+    unsigned int x = CHIP8_NIBBLE(command, 3);
+    unsigned int y = CHIP8_NIBBLE(command, 2);
+
+    switch (CHIP8_NIBBLE(command, 1)) {
+    case 0x0:
+        fprintf(out, "    V(%u) = V(%u);\n", x, y);
+        break;
+    case 0x1:
+        fprintf(out, "    V(%u) = V(%u) | V(%u);\n", x, x, y);
+        break;
+    case 0x2:
+        fprintf(out, "    V(%u) = V(%u) & V(%u);\n", x, x, y);
+        break;
+    case 0x3:
+        fprintf(out, "    V(%u) = V(%u) ^ V(%u);\n", x, x, y);
+        break;
+    case 0x4:
+        fprintf(out, "    add = V(%u) + V(%u);\n", x, y);
+        fprintf(out, "    V(15) = add > 255;\n");
+        fprintf(out, "    V(%u) = add & 0xFF;\n", x);
+        break;
+    case 0x5:
+        fprintf(out, "    V(15) = V(%u) > V(%u);\n", x, y);
+        fprintf(out, "    V(%u) = V(%u) - V(%u);\n", x, x, y);
+        break;
+    case 0x6:
+        fprintf(out, "    V(15) = V(%u) & 0x01;\n", x);
+        fprintf(out, "    V(%u) = V(%u) >> 1;\n", x, x);
+        break;
+    case 0x7:
+        fprintf(out, "    V(15) = V(%u) > V(%u);\n", y, x);
+        fprintf(out, "    V(%u) = V(%u) - V(%u);\n", x, y, x);
+        break;
+    case 0xE:
+        fprintf(out, "    V(15) = V(%u) >> 7;\n", x);
+        fprintf(out, "    V(%u) <<= 1;\n", x);
+        break;
+    default:
+        break;
+    }
+}
+
+static void aot_emit_block(aot_compiler_t *c, uint32_t start)
+{
+    chip8_t           *chip8   = &c->chip8;
+    FILE              *out     = c->out;
+    chip8_aot_block_t *block   = &c->blocks[c->count++];
+    uint32_t           address = start;
+    unsigned int       length  = 0;
+    int                flags   = AOT_FLOWS;
+    unsigned int       size;
+    uint16_t           command;
+
+    fprintf(out,
+            "static int block_%04x(chip8_t *chip8, chip8_aot_execute execute,\n"
+            "                      unsigned int budget, unsigned int *retired)\n"
+            "{\n"
+            "    int      err = CHIP8_OK;\n"
+            "    uint32_t add;\n"
+            "\n"
+            "    (void)execute;\n"
+            "    (void)add;\n",
+            start);
+
+    while (length < CHIP8_AOT_MAX_BLOCK && address + 2 <= c->limit) {
+        command = aot_word(chip8, address);
+        flags   = aot_classify(c, address, command, &size);
+        length++;
+
+        fprintf(out, "\n    /* %03x: %04x */\n", address, command);
+        if (length > 1) {
+            fprintf(out,
+                    "    if (budget == %u) {\n"
+                    "        chip8->program_counter = 0x%03x;\n"
+                    "        *retired = %u;\n"
+                    "        return CHIP8_OK;\n"
+                    "    }\n",
+                    length - 1, address, length - 1);
+        }
+
+        if (flags & AOT_CALL) {
+            fprintf(out,
+                    "    chip8->program_counter = 0x%03x;\n"
+                    "    err = execute(chip8, 0x%04x);\n"
+                    "    if (err != CHIP8_OK) {\n"
+                    "        *retired = %u;\n"
+                    "        return err;\n"
+                    "    }\n",
+                    address, command, length);
+        } else {
+            switch (CHIP8_NIBBLE(command, 4)) {
+            case 0x1:
+                fprintf(out, "    chip8->program_counter = 0x%03x;\n",
+                        command & CHIP8_LSB_MASK(3));
+                break;
+            case 0x6:
+                fprintf(out, "    V(%u) = 0x%02x;\n", CHIP8_NIBBLE(command, 3),
+                        command & 0xFF);
+                break;
+            case 0x7:
+                fprintf(out, "    V(%u) += 0x%02x;\n", CHIP8_NIBBLE(command, 3),
+                        command & 0xFF);
+                break;
+            case 0x8:
+                aot_emit_alu(out, command);
+                break;
+            case 0xA:
+                fprintf(out, "    chip8->i_register = 0x%03x;\n",
+                        command & CHIP8_LSB_MASK(3));
+                break;
+            }
+        }
+
+        address += size;
+        if (flags & AOT_ENDS) {
+            break;
+        }
+    }
+
+    if (!(flags & AOT_ENDS)) {
+        /* ran into the length limit or the end of the image */
+        fprintf(out, "    chip8->program_counter = 0x%03x;\n", address);
+        aot_queue(c, address);
+    }
+
+    fprintf(out,
+            "\n"
+            "    *retired = %u;\n"
+            "    return err;\n"
+            "}\n\n",
+            length);
+
+    block->address = start;
+    block->bytes   = address - start;
+    block->length  = length;
+    block->code    = c->code;
+    c->code += block->bytes;
+}
+
+static int aot_generate(aot_compiler_t *c, const char *rom_file)
+{
+    FILE *out = c->out;
+
+    fprintf(out,
+            "/* generated by chip8-aot from %s, do not edit */\n"
+            "#include \"chip8_aot.h\"\n"
+            "\n"
+            "#define V(x) chip8->registers[x]\n"
+            "\n",
+            rom_file);
+
+    aot_queue(c, CHIP8_ROM_START);
+    while (c->pending) {
+        aot_emit_block(c, c->worklist[--c->pending]);
+    }
+
+    fprintf(out, "static const uint8_t code[] = {");
+    for (uint32_t i = 0; i < c->count; i++) {
+        for (uint32_t j = 0; j < c->blocks[i].bytes; j++) {
+            fprintf(out, "%s0x%02x,",
+                    (c->blocks[i].code + j) % 12 ? " " : "\n    ",
+                    c->chip8.memory[c->blocks[i].address + j]);
+        }
+    }
+    fprintf(out, "\n};\n\nstatic const chip8_aot_block_t blocks[] = {\n");
+    for (uint32_t i = 0; i < c->count; i++) {
+        fprintf(out, "    { 0x%03x, %u, %u, %u, block_%04x },\n",
+                c->blocks[i].address, c->blocks[i].bytes, c->blocks[i].length,
+                c->blocks[i].code, c->blocks[i].address);
+    }
+    fprintf(out,
+            "};\n\n"
+            "const chip8_aot_module_t " CHIP8_AOT_SYMBOL " = {\n"
+            "    .version    = CHIP8_AOT_VERSION,\n"
+            "    .state_size = sizeof(chip8_t),\n"
+            "    .rom_hash   = 0x%016llxull,\n"
+            "    .mode       = %u,\n"
+            "    .count      = %u,\n"
+            "    .blocks     = blocks,\n"
+            "    .code       = code,\n"
+            "};\n",
+            (unsigned long long)c->chip8.rom_hash, (unsigned int)c->chip8.mode,
+            c->count);
+
+    return ferror(out) ? -1 : 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-m mode] [-o dir] [-I dir] [-c compiler] <path to ROM>\n"
+            "  -m mode      chip8, schip or xo (default chip8)\n"
+            "  -o dir       where the module is written (default .)\n"
+            "  -I dir       chip8 headers (default %s)\n"
+            "  -c compiler  C compiler to build the module with (default cc)\n",
+            prog, CHIP8_AOT_INCLUDE_DIR);
+}
+
+int main(int argc, char **argv)
+{
+    aot_compiler_t *c       = &compiler;
+    chip8_mode_t    mode    = CHIP8_MODE_CHIP8;
+    const char     *dir     = ".";
+    const char     *include = CHIP8_AOT_INCLUDE_DIR;
+    const char     *cc      = getenv("CC") ? getenv("CC") : "cc";
+    char            so[4096], source[4096], tmp[4096], cmd[16384];
+    int             opt;
+
+    while ((opt = getopt(argc, argv, "m:o:I:c:")) != -1) {
+        switch (opt) {
+        case 'm':
+            if (chip8_mode_parse(optarg, &mode) != CHIP8_OK) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'o':
+            dir = optarg;
+            break;
+        case 'I':
+            include = optarg;
+            break;
+        case 'c':
+            cc = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (chip8_init(&c->chip8, argv[optind], mode) != CHIP8_OK) {
+        fprintf(stderr, "%s: cannot load %s\n", argv[0], argv[optind]);
+        return 1;
+    }
+    c->limit = CHIP8_ROM_START + c->chip8.rom_size;
+
+    if (chip8_aot_path(so, sizeof(so), dir, c->chip8.rom_hash, mode) !=
+        CHIP8_OK) {
+        fprintf(stderr, "%s: output path too long\n", argv[0]);
+        return 1;
+    }
+    snprintf(source, sizeof(source), "%.*s.c", (int)strlen(so) - 3, so);
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", so, (int)getpid());
+
+    c->out = fopen(source, "w");
+    if (!c->out) {
+        perror(source);
+        return 1;
+    }
+    if (aot_generate(c, argv[optind]) != 0 || fclose(c->out) != 0) {
+        fprintf(stderr, "%s: cannot write %s\n", argv[0], source);
+        return 1;
+    }
+
+    /* build next to the target and rename, so a loader never sees half */
+    snprintf(cmd, sizeof(cmd), "'%s' -O2 -shared -fPIC -I'%s' -o '%s' '%s'",
+             cc, include, tmp, source);
+    if (system(cmd) != 0 || rename(tmp, so) != 0) {
+        fprintf(stderr, "%s: failed to build %s\n", argv[0], so);
+        unlink(tmp);
+        return 1;
+    }
+
+    printf("%s: %u blocks\n", so, c->count);
+    return 0;
+}
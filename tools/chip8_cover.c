@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "chip8_cover.h"
+
+/**
+ * chip8-cover: OR any number of coverage files for one ROM together,
+ * optionally save the result, and print the ROM as an annotated
+ * disassembly: '*' marks instructions that ran, and each executed skip
+ * says which ways it went.
+ */
+
+static chip8_t       chip8;
+static chip8_cover_t cover;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-m mode] [-o file] <path to ROM> <coverage>...\n"
+            "  -m mode  chip8, schip or xo, as the runs used (default chip8)\n"
+            "  -o file  also merge the result into file\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    chip8_mode_t mode   = CHIP8_MODE_CHIP8;
+    const char  *output = NULL;
+    int          opt;
+    int          err;
+
+    while ((opt = getopt(argc, argv, "m:o:")) != -1) {
+        switch (opt) {
+        case 'm':
+            if (chip8_mode_parse(optarg, &mode) != CHIP8_OK) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - optind < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (chip8_init(&chip8, argv[optind], mode) != CHIP8_OK) {
+        fprintf(stderr, "%s: cannot load %s\n", argv[0], argv[optind]);
+        return 1;
+    }
+    chip8_cover_init(&cover, &chip8);
+
+    for (int i = optind + 1; i < argc; i++) {
+        err = chip8_cover_load(&cover, argv[i]);
+        if (err != CHIP8_OK) {
+            fprintf(stderr, "%s: %s: %s\n", argv[0], argv[i],
+                    err == CHIP8_ROM_ERR ? "not coverage of this ROM and mode"
+                                         : "cannot read");
+            return 1;
+        }
+    }
+
+    if (output && chip8_cover_save(&cover, output) != CHIP8_OK) {
+        fprintf(stderr, "%s: cannot write %s\n", argv[0], output);
+        return 1;
+    }
+
+    err = chip8_cover_write_listing(&cover, stdout);
+
+    chip8_cover_cleanup(&cover);
+    chip8_cleanup(&chip8);
+
+    return err == CHIP8_OK ? 0 : 1;
+}
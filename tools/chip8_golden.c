@@ -0,0 +1,540 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "chip8_aot.h"
+#include "chip8_decode.h"
+
+/**
+ * chip8-golden: run every ROM of a golden file headless, each with its own
+ * scripted input, hash the framebuffer at chosen frames and compare the
+ * hashes with the ones in the file. ROMs run in parallel, one per core.
+ *
+ * One case per line, blank lines and lines starting with '#' are kept as
+ * they are:
+ *
+ *     <rom> <mode> <frames> <input> <frame>[:<hash>]...
+ *
+ * The ROM path is relative to the golden file. Input is '-' for none, or a
+ * comma separated list of <frame>+<key> (press) and <frame>-<key> (release)
+ * in frame order, applied before that frame runs. Frames count from 1, and
+ * a hash is taken after the frame ran and the timers ticked. The random
+ * seed is fixed, so a run only depends on the ROM, the mode and the input.
+ *
+ * -u records the hashes instead, rewriting the file in place.
+ */
+
+#define GOLDEN_SEED   (0x2545F491)
+#define GOLDEN_LINE   (1024)
+#define GOLDEN_EVENTS (64)
+#define GOLDEN_POINTS (16)
+
+typedef enum
+{
+    GOLDEN_INTERPRET = 0,
+    GOLDEN_DECODE,
+    GOLDEN_AOT,
+} golden_engine_t;
+
+typedef struct
+{
+    uint32_t          frame;
+    uint8_t           key;
+    chip8_key_state_t state;
+} golden_event_t;
+
+typedef struct
+{
+    uint32_t frame;
+    bool     known; /* the file has a hash for it */
+    uint64_t hash;
+    uint64_t result;
+} golden_point_t;
+
+typedef struct
+{
+    char  text[GOLDEN_LINE];
+    bool  run; /* a case, not a comment */
+    char *rom;
+    char *input;
+
+    chip8_mode_t   mode;
+    uint32_t       frames;
+    golden_event_t events[GOLDEN_EVENTS];
+    uint32_t       events_count;
+    golden_point_t points[GOLDEN_POINTS];
+    uint32_t       points_count;
+
+    /* result */
+    int      err;
+    uint32_t err_frame; /* 0 when it failed to start */
+} golden_case_t;
+
+typedef struct
+{
+    chip8_t         chip8;
+    chip8_decoder_t decoder;
+    chip8_aot_t     aot;
+} golden_machine_t;
+
+static golden_case_t  *cases;
+static size_t          cases_count;
+static char            base[PATH_MAX];
+static golden_engine_t engine    = GOLDEN_INTERPRET;
+static uint32_t        fuse_mask = CHIP8_FUSE_ALL;
+static const char     *aot_dir;
+static atomic_size_t   next_case;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-j jobs] [-e engine] [-f list] [-a dir] [-u] "
+            "<golden file>\n"
+            "  -j jobs    ROMs run at once (default: one per core)\n"
+            "  -e engine  interpret (default) or decode\n"
+            "  -f list    decoder fusion patterns, as for chip8 -f\n"
+            "  -a dir     run the ahead-of-time compiled modules in dir\n"
+            "  -u         record the hashes into the golden file instead\n",
+            prog);
+}
+
+/* <frame>+<key> or <frame>-<key>, comma separated */
+static int golden_parse_input(golden_case_t *test, char *input)
+{
+    char          *save;
+    char          *end;
+    unsigned long  frame;
+    unsigned long  key;
+    golden_event_t event;
+
+    if (strcmp(input, "-") == 0) {
+        return CHIP8_OK;
+    }
+
+    for (char *item = strtok_r(input, ",", &save); item;
+         item        = strtok_r(NULL, ",", &save)) {
+        frame = strtoul(item, &end, 10);
+        if ((*end != '+' && *end != '-') || end == item) {
+            return CHIP8_ERR;
+        }
+        event.state = *end == '+' ? CHIP8_KEY_PRESSED : CHIP8_KEY_IDLE;
+        key         = strtoul(end + 1, &end, 16);
+        if (*end || key > CHIP8_KEYPAD_SIZE ||
+            test->events_count == GOLDEN_EVENTS ||
+            (test->events_count &&
+             frame < test->events[test->events_count - 1].frame)) {
+            return CHIP8_ERR;
+        }
+        event.frame = frame;
+        event.key   = key;
+
+        test->events[test->events_count++] = event;
+    }
+
+    return CHIP8_OK;
+}
+
+static int golden_parse(golden_case_t *test)
+{
+    char          *save;
+    char          *mode;
+    char          *frames;
+    char          *input;
+    char          *end;
+    char          *first;
+    char           copy[GOLDEN_LINE];
+    golden_point_t point;
+
+    first = test->text + strspn(test->text, " \t");
+    if (*first == '#' || *first == '\n' || *first == '\0') {
+        return CHIP8_OK;
+    }
+
+    /* tokens point into text, the input list is cut up on a copy */
+    test->run   = true;
+    test->rom   = strtok_r(test->text, " \t\n", &save);
+    mode        = strtok_r(NULL, " \t\n", &save);
+    frames      = strtok_r(NULL, " \t\n", &save);
+    input       = strtok_r(NULL, " \t\n", &save);
+    test->input = input;
+    if (!input || chip8_mode_parse(mode, &test->mode) != CHIP8_OK) {
+        return CHIP8_ERR;
+    }
+
+    test->frames = strtoul(frames, &end, 10);
+    if (*end || test->frames == 0) {
+        return CHIP8_ERR;
+    }
+
+    snprintf(copy, sizeof(copy), "%s", input);
+    if (golden_parse_input(test, copy) != CHIP8_OK) {
+        return CHIP8_ERR;
+    }
+
+    for (char *item = strtok_r(NULL, " \t\n", &save); item;
+         item       = strtok_r(NULL, " \t\n", &save)) {
+        memset(&point, 0, sizeof(point));
+        point.frame = strtoul(item, &end, 10);
+        if (*end == ':') {
+            point.hash  = strtoull(end + 1, &end, 16);
+            point.known = true;
+        }
+        if (*end || point.frame == 0 || point.frame > test->frames ||
+            test->points_count == GOLDEN_POINTS ||
+            (test->points_count &&
+             point.frame <= test->points[test->points_count - 1].frame)) {
+            return CHIP8_ERR;
+        }
+        test->points[test->points_count++] = point;
+    }
+
+    /* no frames listed: hash the last one */
+    if (test->points_count == 0) {
+        test->points[0].frame = test->frames;
+        test->points_count    = 1;
+    }
+
+    return CHIP8_OK;
+}
+
+static int golden_load(const char *path)
+{
+    FILE          *in = fopen(path, "r");
+    char           line[GOLDEN_LINE];
+    size_t         size = 0;
+    golden_case_t *more;
+    char          *slash;
+
+    if (!in) {
+        perror(path);
+        return CHIP8_ERR;
+    }
+
+    snprintf(base, sizeof(base), "%s", path);
+    slash = strrchr(base, '/');
+    if (slash) {
+        slash[1] = '\0';
+    } else {
+        base[0] = '\0';
+    }
+
+    while (fgets(line, sizeof(line), in)) {
+        if (cases_count == size) {
+            size = size ? size * 2 : 64;
+            more = realloc(cases, size * sizeof(golden_case_t));
+            if (!more) {
+                fclose(in);
+                return CHIP8_ALLOC_ERR;
+            }
+            cases = more;
+        }
+        memset(&cases[cases_count], 0, sizeof(golden_case_t));
+        snprintf(cases[cases_count].text, GOLDEN_LINE, "%s", line);
+        cases_count++;
+    }
+    fclose(in);
+
+    /* only once the array stopped moving, the tokens point into it */
+    for (size_t i = 0; i < cases_count; i++) {
+        if (golden_parse(&cases[i]) != CHIP8_OK) {
+            fprintf(stderr, "%s:%zu: bad case\n", path, i + 1);
+            return CHIP8_ERR;
+        }
+    }
+
+    return CHIP8_OK;
+}
+
+/* what the ROM shows: the resolution and every bitplane */
+static uint64_t golden_hash(const chip8_t *chip8)
+{
+    uint64_t hash = chip8_fnv1a(CHIP8_FNV_OFFSET, &chip8->hires,
+                                sizeof(chip8->hires));
+
+    return chip8_fnv1a(hash, chip8->display, sizeof(chip8->display));
+}
+
+static int golden_engine_init(golden_machine_t *machine)
+{
+    switch (engine) {
+    case GOLDEN_DECODE:
+        return chip8_decoder_init(&machine->decoder, &machine->chip8,
+                                  fuse_mask);
+    case GOLDEN_AOT:
+        return chip8_aot_init(&machine->aot, &machine->chip8, aot_dir);
+    default:
+        return CHIP8_OK;
+    }
+}
+
+static void golden_engine_cleanup(golden_machine_t *machine)
+{
+    switch (engine) {
+    case GOLDEN_DECODE:
+        chip8_decoder_cleanup(&machine->decoder);
+        break;
+    case GOLDEN_AOT:
+        chip8_aot_cleanup(&machine->aot);
+        break;
+    default:
+        break;
+    }
+}
+
+static void golden_run(golden_case_t *test, golden_machine_t *machine)
+{
+    chip8_t *chip8 = &machine->chip8;
+    char     rom[PATH_MAX];
+    uint32_t event = 0;
+    uint32_t point = 0;
+
+    if (test->rom[0] == '/') {
+        snprintf(rom, sizeof(rom), "%s", test->rom);
+    } else {
+        snprintf(rom, sizeof(rom), "%s%s", base, test->rom);
+    }
+
+    test->err = chip8_init(chip8, rom, test->mode);
+    if (test->err != CHIP8_OK) {
+        return;
+    }
+    chip8->rng = GOLDEN_SEED;
+
+    test->err = golden_engine_init(machine);
+    if (test->err != CHIP8_OK) {
+        chip8_cleanup(chip8);
+        return;
+    }
+
+    for (uint32_t frame = 1; frame <= test->frames; frame++) {
+        while (event < test->events_count &&
+               test->events[event].frame <= frame) {
+            chip8_keypad_set(chip8, test->events[event].key,
+                             test->events[event].state);
+            event++;
+        }
+
+        /* a ROM waiting on Fx0A just ends its frame early */
+        test->err = chip8_run(chip8, CHIP8_CYCLES_PER_FRAME, NULL);
+        if (test->err == CHIP8_KEY_WAIT) {
+            test->err = CHIP8_OK;
+        }
+        chip8_tick_timers(chip8);
+
+        if (test->err != CHIP8_OK) {
+            test->err_frame = frame;
+            break;
+        }
+        if (test->points[point].frame == frame) {
+            test->points[point++].result = golden_hash(chip8);
+        }
+    }
+
+    golden_engine_cleanup(machine);
+    chip8_cleanup(chip8);
+}
+
+static void *golden_worker(void *arg)
+{
+    golden_machine_t *machine = malloc(sizeof(golden_machine_t));
+    size_t            i;
+
+    (void)arg;
+
+    while ((i = atomic_fetch_add(&next_case, 1)) < cases_count) {
+        if (!cases[i].run) {
+            continue;
+        }
+        if (!machine) {
+            cases[i].err = CHIP8_ALLOC_ERR;
+            continue;
+        }
+        memset(machine, 0, sizeof(golden_machine_t));
+        golden_run(&cases[i], machine);
+    }
+
+    free(machine);
+
+    return NULL;
+}
+
+/* prints the case's verdict, true if it passed */
+static bool golden_report(const golden_case_t *test, bool update)
+{
+    const char *mode = chip8_mode_name(test->mode);
+
+    if (test->err != CHIP8_OK && test->err_frame == 0) {
+        printf("FAIL %s %s: cannot start, error %d\n", test->rom, mode,
+               test->err);
+        return false;
+    }
+    if (test->err != CHIP8_OK) {
+        printf("FAIL %s %s: error %d in frame %u\n", test->rom, mode,
+               test->err, test->err_frame);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < test->points_count && !update; i++) {
+        const golden_point_t *point = &test->points[i];
+
+        if (!point->known) {
+            printf("FAIL %s %s: no hash for frame %u, got %016llx\n",
+                   test->rom, mode, point->frame,
+                   (unsigned long long)point->result);
+            return false;
+        }
+        if (point->hash != point->result) {
+            printf("FAIL %s %s: frame %u is %016llx, expected %016llx\n",
+                   test->rom, mode, point->frame,
+                   (unsigned long long)point->result,
+                   (unsigned long long)point->hash);
+            return false;
+        }
+    }
+
+    printf("ok   %s %s\n", test->rom, mode);
+
+    return true;
+}
+
+static int golden_save(const char *path)
+{
+    char  tmp[PATH_MAX];
+    FILE *out;
+    int   ok;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    out = fopen(tmp, "w");
+    if (!out) {
+        perror(tmp);
+        return CHIP8_ERR;
+    }
+
+    for (size_t i = 0; i < cases_count; i++) {
+        const golden_case_t *test = &cases[i];
+
+        if (!test->run) {
+            fputs(test->text, out);
+            continue;
+        }
+
+        fprintf(out, "%s %s %u %s", test->rom, chip8_mode_name(test->mode),
+                test->frames, test->input);
+        for (uint32_t j = 0; j < test->points_count; j++) {
+            fprintf(out, " %u:%016llx", test->points[j].frame,
+                    (unsigned long long)test->points[j].result);
+        }
+        fputc('\n', out);
+    }
+
+    ok = !ferror(out);
+    ok &= fclose(out) == 0;
+    if (!ok || rename(tmp, path) != 0) {
+        perror(path);
+        unlink(tmp);
+        return CHIP8_ERR;
+    }
+
+    return CHIP8_OK;
+}
+
+int main(int argc, char **argv)
+{
+    long       jobs   = sysconf(_SC_NPROCESSORS_ONLN);
+    bool       update = false;
+    size_t     passed = 0;
+    size_t     total  = 0;
+    pthread_t *threads;
+    int        opt;
+
+    while ((opt = getopt(argc, argv, "j:e:f:a:u")) != -1) {
+        switch (opt) {
+        case 'j':
+            jobs = strtol(optarg, NULL, 0);
+            break;
+        case 'e':
+            if (strcmp(optarg, "interpret") == 0) {
+                engine = GOLDEN_INTERPRET;
+            } else if (strcmp(optarg, "decode") == 0) {
+                engine = GOLDEN_DECODE;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'f':
+            if (chip8_fuse_parse(optarg, &fuse_mask) != CHIP8_OK) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'a':
+            engine  = GOLDEN_AOT;
+            aot_dir = optarg;
+            break;
+        case 'u':
+            update = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (golden_load(argv[optind]) != CHIP8_OK) {
+        return 1;
+    }
+
+    if (jobs < 1) {
+        jobs = 1;
+    }
+    if ((size_t)jobs > cases_count) {
+        jobs = cases_count ? cases_count : 1;
+    }
+
+    threads = calloc(jobs, sizeof(pthread_t));
+    if (!threads) {
+        return 1;
+    }
+    for (long i = 0; i < jobs; i++) {
+        if (pthread_create(&threads[i], NULL, golden_worker, NULL) != 0) {
+            jobs = i;
+            break;
+        }
+    }
+    /* with no thread at all, the main one does the work */
+    if (jobs == 0) {
+        golden_worker(NULL);
+    }
+    for (long i = 0; i < jobs; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    for (size_t i = 0; i < cases_count; i++) {
+        if (cases[i].run) {
+            total++;
+            passed += golden_report(&cases[i], update);
+        }
+    }
+    printf("%zu of %zu passed\n", passed, total);
+
+    if (update && passed == total &&
+        golden_save(argv[optind]) != CHIP8_OK) {
+        return 1;
+    }
+    free(cases);
+
+    return passed == total ? 0 : 1;
+}
@@ -0,0 +1,409 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "chip8_aot.h"
+#include "chip8_cover.h"
+#include "chip8_decode.h"
+#include "chip8_lockstep.h"
+
+/**
+ * chip8-lockstep: run a ROM on the interpreter and on a candidate engine
+ * side by side and stop at the first point they disagree, see
+ * chip8_lockstep.h. The keys change at random, so key waits and skips go
+ * both ways. They and the Cxkk seed come from -S, so a run repeats exactly.
+ *
+ * With -z the ROMs are random instead. Every instruction slot is drawn
+ * from a table of all valid encodings with equal weight, so each opcode
+ * gets about the same share of a run. Operands are random too. Jumps and
+ * calls land inside the ROM, and I points into it half the time, so
+ * stores rewrite code. The sequences the decoder fuses are planted on
+ * purpose, as random code would hardly ever contain them. A ROM that
+ * diverges is kept as lockstep-<seed>.ch8, to rerun with the same -S.
+ */
+
+#define LOCKSTEP_FRAMES    (600)
+#define LOCKSTEP_ROM_WORDS (256)
+
+typedef enum
+{
+    LOCKSTEP_INTERPRET = 0,
+    LOCKSTEP_DECODE,
+    LOCKSTEP_COVER,
+    LOCKSTEP_AOT,
+} lockstep_engine_t;
+
+typedef struct
+{
+    chip8_t          reference;
+    chip8_t          candidate;
+    chip8_decoder_t  decoder;
+    chip8_cover_t    cover;
+    chip8_aot_t      aot;
+    chip8_lockstep_t lockstep;
+} lockstep_machines_t;
+
+/* pattern | (random & free) */
+typedef struct
+{
+    uint16_t pattern;
+    uint16_t free;
+} lockstep_opcode_t;
+
+static const lockstep_opcode_t lockstep_opcodes[] = {
+    { 0x00E0, 0x0000 }, { 0x00EE, 0x0000 }, { 0x00C0, 0x000F },
+    { 0x00FB, 0x0000 }, { 0x00FC, 0x0000 }, { 0x00FE, 0x0000 },
+    { 0x00FF, 0x0000 }, { 0x1000, 0x0FFF }, { 0x2000, 0x0FFF },
+    { 0x3000, 0x0FFF }, { 0x4000, 0x0FFF }, { 0x5000, 0x0FF0 },
+    { 0x6000, 0x0FFF }, { 0x7000, 0x0FFF }, { 0x8000, 0x0FF0 },
+    { 0x8001, 0x0FF0 }, { 0x8002, 0x0FF0 }, { 0x8003, 0x0FF0 },
+    { 0x8004, 0x0FF0 }, { 0x8005, 0x0FF0 }, { 0x8006, 0x0FF0 },
+    { 0x8007, 0x0FF0 }, { 0x800E, 0x0FF0 }, { 0x9000, 0x0FF0 },
+    { 0xA000, 0x0FFF }, { 0xB000, 0x0FFF }, { 0xC000, 0x0FFF },
+    { 0xD000, 0x0FFF }, { 0xE09E, 0x0F00 }, { 0xE0A1, 0x0F00 },
+    { 0xF00A, 0x0F00 }, { 0xF007, 0x0F00 }, { 0xF015, 0x0F00 },
+    { 0xF018, 0x0F00 }, { 0xF01E, 0x0F00 }, { 0xF029, 0x0F00 },
+    { 0xF030, 0x0F00 }, { 0xF033, 0x0F00 }, { 0xF055, 0x0F00 },
+    { 0xF065, 0x0F00 }, { 0xF075, 0x0F00 }, { 0xF085, 0x0F00 },
+    /* XO-CHIP only, the other modes reject them */
+    { 0x00D0, 0x000F }, { 0x5002, 0x0FF0 }, { 0x5003, 0x0FF0 },
+    { 0xF000, 0x0000 }, { 0xF001, 0x0F00 }, { 0xF002, 0x0000 },
+    { 0xF03A, 0x0F00 },
+};
+
+#define LOCKSTEP_OPCODES                                                       \
+    (sizeof(lockstep_opcodes) / sizeof(lockstep_opcodes[0]))
+#define LOCKSTEP_XOCHIP_OPCODES (7) /* at the end of lockstep_opcodes */
+
+static lockstep_engine_t engine    = LOCKSTEP_DECODE;
+static uint32_t          fuse_mask = CHIP8_FUSE_ALL;
+static const char       *aot_dir;
+static chip8_mode_t      mode   = CHIP8_MODE_CHIP8;
+static unsigned int      step   = CHIP8_LOCKSTEP_STEP;
+static unsigned int      frames = LOCKSTEP_FRAMES;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <path to ROM>\n"
+            "       %s [options] -z count\n"
+            "  -m mode    chip8 (default), schip or xo\n"
+            "  -e engine  candidate: decode (default), cover or interpret\n"
+            "  -f list    decoder fusion patterns, as for chip8 -f\n"
+            "  -a dir     candidate runs the ahead-of-time module in dir\n"
+            "  -s step    candidate instructions per comparison (default %d)\n"
+            "  -n frames  frames to run each ROM for (default %d)\n"
+            "  -S seed    key presses, and the first random ROM with -z\n"
+            "  -z count   run count random ROMs instead\n",
+            prog, prog, CHIP8_LOCKSTEP_STEP, LOCKSTEP_FRAMES);
+}
+
+static uint32_t lockstep_random(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+
+    return *state;
+}
+
+/* an even address inside the ROM */
+static uint16_t lockstep_target(uint32_t *state)
+{
+    return CHIP8_ROM_START + (lockstep_random(state) % LOCKSTEP_ROM_WORDS) * 2;
+}
+
+static uint16_t lockstep_opcode(uint32_t *state)
+{
+    uint32_t                 count = LOCKSTEP_OPCODES;
+    const lockstep_opcode_t *opcode;
+    uint16_t                 operands;
+
+    if (mode != CHIP8_MODE_XOCHIP) {
+        count -= LOCKSTEP_XOCHIP_OPCODES;
+    }
+    opcode   = &lockstep_opcodes[lockstep_random(state) % count];
+    operands = lockstep_random(state) & opcode->free;
+
+    switch (opcode->pattern) {
+    case 0x1000:
+    case 0x2000:
+    case 0xB000:
+        return opcode->pattern | lockstep_target(state);
+    case 0xA000:
+        return lockstep_random(state) & 1 ? 0xA000 | lockstep_target(state)
+                                          : 0xA000 | operands;
+    default:
+        return opcode->pattern | operands;
+    }
+}
+
+static void lockstep_put(uint8_t *rom, uint32_t *at, uint16_t command)
+{
+    if (*at + 2 <= LOCKSTEP_ROM_WORDS * 2) {
+        rom[(*at)++] = command >> 8;
+        rom[(*at)++] = command & 0xFF;
+    }
+}
+
+static void lockstep_generate(uint8_t *rom, uint32_t seed)
+{
+    uint32_t state = seed ? seed : 1;
+    uint32_t at    = 0;
+    uint16_t x;
+    uint16_t y;
+    uint16_t kk;
+
+    while (at < LOCKSTEP_ROM_WORDS * 2) {
+        x  = lockstep_random(&state) & 0xF;
+        y  = lockstep_random(&state) & 0xF;
+        kk = lockstep_random(&state) & 0xFF;
+
+        switch (lockstep_random(&state) % 16) {
+        /* load-draw: Annn, Dxyn */
+        case 0:
+            lockstep_put(rom, &at, 0xA000 | lockstep_target(&state));
+            lockstep_put(rom, &at, 0xD000 | x << 8 | y << 4 | (kk & 0xF));
+            break;
+        /* load-load: 6xkk, 6ykk */
+        case 1:
+            lockstep_put(rom, &at, 0x6000 | x << 8 | kk);
+            lockstep_put(rom, &at, 0x6000 | y << 8 | (kk ^ 0x5A));
+            break;
+        /* count-loop: 7x01, 3xkk, 1nnn back to the 7x01 */
+        case 2:
+            lockstep_put(rom, &at, 0x7001 | x << 8);
+            lockstep_put(rom, &at, 0x3000 | x << 8 | kk);
+            lockstep_put(rom, &at, 0x1000 | (CHIP8_ROM_START + at - 4));
+            break;
+        default:
+            lockstep_put(rom, &at, lockstep_opcode(&state));
+            break;
+        }
+    }
+}
+
+static int lockstep_engine_init(lockstep_machines_t *machines)
+{
+    switch (engine) {
+    case LOCKSTEP_DECODE:
+        return chip8_decoder_init(&machines->decoder, &machines->candidate,
+                                  fuse_mask);
+    case LOCKSTEP_COVER:
+        return chip8_cover_init(&machines->cover, &machines->candidate);
+    case LOCKSTEP_AOT:
+        return chip8_aot_init(&machines->aot, &machines->candidate, aot_dir);
+    default:
+        return CHIP8_OK;
+    }
+}
+
+static void lockstep_engine_cleanup(lockstep_machines_t *machines)
+{
+    switch (engine) {
+    case LOCKSTEP_DECODE:
+        chip8_decoder_cleanup(&machines->decoder);
+        break;
+    case LOCKSTEP_COVER:
+        chip8_cover_cleanup(&machines->cover);
+        break;
+    case LOCKSTEP_AOT:
+        chip8_aot_cleanup(&machines->aot);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * CHIP8_OK when both engines agreed for every frame, or ran into the same
+ * error. CHIP8_DIVERGED after the report was printed, other errors if the
+ * machines could not be set up.
+ */
+static int lockstep_rom(lockstep_machines_t *machines, const char *rom,
+                        uint32_t seed)
+{
+    chip8_lockstep_t *lockstep = &machines->lockstep;
+    uint32_t          keys     = seed ? seed : 1;
+    uint32_t          random;
+    int               err;
+
+    memset(machines, 0, sizeof(lockstep_machines_t));
+    err = chip8_init(&machines->reference, rom, mode);
+    if (err != CHIP8_OK) {
+        return err;
+    }
+    err = chip8_init(&machines->candidate, rom, mode);
+    if (err != CHIP8_OK) {
+        chip8_cleanup(&machines->reference);
+        return err;
+    }
+    err = lockstep_engine_init(machines);
+    if (err != CHIP8_OK) {
+        chip8_cleanup(&machines->candidate);
+        chip8_cleanup(&machines->reference);
+        return err;
+    }
+    /* the candidate takes it over, and a rerun with -S gets it back */
+    machines->reference.rng = keys;
+    chip8_lockstep_init(lockstep, &machines->reference, &machines->candidate,
+                        step);
+
+    for (unsigned int frame = 0; frame < frames && err == CHIP8_OK; frame++) {
+        /* about every eighth frame, one key changes */
+        random = lockstep_random(&keys);
+        if ((random & 7) == 0) {
+            chip8_lockstep_keypad_set(lockstep, (random >> 3) & 0xF,
+                                      (random >> 7) & 1 ? CHIP8_KEY_PRESSED
+                                                        : CHIP8_KEY_IDLE);
+        }
+
+        err = chip8_lockstep_run(lockstep, CHIP8_CYCLES_PER_FRAME, NULL);
+        if (err == CHIP8_KEY_WAIT) {
+            err = CHIP8_OK;
+        }
+        chip8_lockstep_tick_timers(lockstep);
+    }
+
+    /* an error both engines agree on is not a failure */
+    if (err == CHIP8_DIVERGED) {
+        chip8_lockstep_write_report(lockstep, stdout);
+    } else {
+        err = CHIP8_OK;
+    }
+
+    lockstep_engine_cleanup(machines);
+    chip8_cleanup(&machines->candidate);
+    chip8_cleanup(&machines->reference);
+
+    return err;
+}
+
+static int lockstep_fuzz(lockstep_machines_t *machines, unsigned long count,
+                         uint32_t seed)
+{
+    uint8_t       rom[LOCKSTEP_ROM_WORDS * 2];
+    char          path[64];
+    FILE         *out;
+    uint64_t      instructions = 0;
+    int           err          = CHIP8_OK;
+    unsigned long i;
+
+    for (i = 0; i < count && err == CHIP8_OK; seed++) {
+        lockstep_generate(rom, seed);
+
+        snprintf(path, sizeof(path), "lockstep-%u.ch8", seed);
+        out = fopen(path, "wb");
+        if (!out || fwrite(rom, sizeof(rom), 1, out) != 1) {
+            perror(path);
+            if (out) {
+                fclose(out);
+            }
+            return CHIP8_ERR;
+        }
+        fclose(out);
+
+        err = lockstep_rom(machines, path, seed);
+        instructions += machines->lockstep.instructions;
+        i++;
+        if (err == CHIP8_DIVERGED) {
+            printf("kept %s, rerun with -m %s -S %u\n", path,
+                   chip8_mode_name(mode), seed);
+            break;
+        }
+        unlink(path);
+    }
+
+    printf("%lu ROMs, %llu instructions agreed\n", i,
+           (unsigned long long)instructions);
+
+    return err;
+}
+
+int main(int argc, char **argv)
+{
+    lockstep_machines_t *machines;
+    unsigned long        fuzz = 0;
+    uint32_t             seed = 1;
+    int                  opt;
+    int                  err;
+
+    while ((opt = getopt(argc, argv, "m:e:f:a:s:n:S:z:")) != -1) {
+        switch (opt) {
+        case 'm':
+            if (chip8_mode_parse(optarg, &mode) != CHIP8_OK) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'e':
+            if (strcmp(optarg, "decode") == 0) {
+                engine = LOCKSTEP_DECODE;
+            } else if (strcmp(optarg, "cover") == 0) {
+                engine = LOCKSTEP_COVER;
+            } else if (strcmp(optarg, "interpret") == 0) {
+                engine = LOCKSTEP_INTERPRET;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'f':
+            if (chip8_fuse_parse(optarg, &fuse_mask) != CHIP8_OK) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'a':
+            engine  = LOCKSTEP_AOT;
+            aot_dir = optarg;
+            break;
+        case 's':
+            step = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            frames = strtoul(optarg, NULL, 0);
+            break;
+        case 'S':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'z':
+            fuzz = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!fuzz && optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    machines = malloc(sizeof(lockstep_machines_t));
+    if (!machines) {
+        return 1;
+    }
+
+    if (fuzz) {
+        err = lockstep_fuzz(machines, fuzz, seed);
+    } else {
+        err = lockstep_rom(machines, argv[optind], seed);
+        if (err == CHIP8_OK) {
+            printf("%llu instructions agreed\n",
+                   (unsigned long long)machines->lockstep.instructions);
+        }
+    }
+    if (err != CHIP8_OK && err != CHIP8_DIVERGED) {
+        fprintf(stderr, "%s: cannot set up the machines, error %d\n", argv[0],
+                err);
+    }
+
+    free(machines);
+
+    return err == CHIP8_OK ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "chip8.h"
+#include "chip8_stats.h"
+
+/**
+ * chip8-top: show the stats block of every running emulator, see
+ * chip8_stats.h. Blocks are mapped read-only and only ever read, so the
+ * emulators cannot tell they are being watched.
+ */
+
+#define TOP_MAX_BLOCKS (256)
+#define TOP_STALE_NS   (2000000000ULL)
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n count] [-d ms]\n"
+            "  -n count  stop after count refreshes\n"
+            "  -d ms     refresh every ms milliseconds (1000)\n",
+            prog);
+}
+
+static const chip8_stats_block_t *top_map(const char *path)
+{
+    const chip8_stats_block_t *block;
+    struct stat                st;
+    int                        fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(*block)) {
+        close(fd);
+        return NULL;
+    }
+
+    block = mmap(NULL, sizeof(*block), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (block == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (memcmp(block->magic, CHIP8_STATS_MAGIC, sizeof(block->magic)) != 0 ||
+        block->version != CHIP8_STATS_VERSION ||
+        block->size != sizeof(*block)) {
+        munmap((void *)block, sizeof(*block));
+        return NULL;
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    return block;
+}
+
+/* a block outlives an emulator that crashed */
+static int top_alive(const chip8_stats_block_t *block)
+{
+    return kill(block->pid, 0) == 0 || errno == EPERM;
+}
+
+static void top_print(const chip8_stats_block_t *block, uint64_t now)
+{
+    chip8_stats_sample_t sample;
+    const char          *mode = chip8_mode_name(block->mode);
+    const char          *state;
+
+    if (chip8_stats_read(block, &sample) != CHIP8_OK) {
+        printf("%7d  %-20.20s  (busy)\n", block->pid, block->rom);
+        return;
+    }
+
+    if (!top_alive(block)) {
+        state = "dead";
+    } else if (sample.updated_ns == 0 ||
+               now - sample.updated_ns > TOP_STALE_NS) {
+        state = "stall";
+    } else {
+        state = sample.turbo ? "turbo" : "run";
+    }
+
+    printf("%7d  %-20.20s %-6s %-5s %8.2f %12llu %9llu %6.2f %6.2f %6.2f "
+           "%6.2f %8.2f  %03X\n",
+           block->pid, block->rom, mode ? mode : "?", state, sample.mips,
+           (unsigned long long)sample.instructions,
+           (unsigned long long)sample.frames, sample.frame_p50_us / 1e3,
+           sample.frame_p95_us / 1e3, sample.frame_p99_us / 1e3,
+           sample.frame_max_us / 1e3, sample.drift_us / 1e3, sample.pc);
+}
+
+static int top_refresh(void)
+{
+    const chip8_stats_block_t *blocks[TOP_MAX_BLOCKS];
+    char                       path[512];
+    struct dirent             *entry;
+    uint64_t                   now   = chip8_stats_now();
+    int                        count = 0;
+    DIR                       *dir   = opendir(CHIP8_STATS_DIR);
+
+    if (!dir) {
+        perror(CHIP8_STATS_DIR);
+        return 1;
+    }
+
+    while ((entry = readdir(dir)) && count < TOP_MAX_BLOCKS) {
+        if (strncmp(entry->d_name, CHIP8_STATS_PREFIX,
+                    strlen(CHIP8_STATS_PREFIX)) != 0) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", CHIP8_STATS_DIR, entry->d_name);
+        blocks[count] = top_map(path);
+        if (blocks[count]) {
+            count++;
+        }
+    }
+    closedir(dir);
+
+    printf("%7s  %-20s %-6s %-5s %8s %12s %9s %6s %6s %6s %6s %8s  %s\n",
+           "PID", "ROM", "MODE", "STATE", "MIPS", "INSTR", "FRAMES", "P50",
+           "P95", "P99", "MAX", "DRIFT", "PC");
+    for (int i = 0; i < count; i++) {
+        top_print(blocks[i], now);
+        munmap((void *)blocks[i], sizeof(chip8_stats_block_t));
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long   limit = 0;
+    unsigned long   delay = 1000;
+    int             tty   = isatty(STDOUT_FILENO);
+    struct timespec period;
+    int             opt;
+
+    while ((opt = getopt(argc, argv, "n:d:")) != -1) {
+        switch (opt) {
+        case 'n':
+            limit = strtoul(optarg, NULL, 0);
+            break;
+        case 'd':
+            delay = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    period.tv_sec  = delay / 1000;
+    period.tv_nsec = (delay % 1000) * 1000000L;
+
+    for (unsigned long shown = 0; !limit || shown < limit; shown++) {
+        if (shown) {
+            nanosleep(&period, NULL);
+        }
+        if (tty) {
+            /* home and clear, so the table redraws in place */
+            printf("\033[H\033[J");
+        }
+        if (top_refresh() != 0) {
+            return 1;
+        }
+        printf("  frame times and drift in ms\n");
+        fflush(stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "chip8_disasm.h"
+#include "chip8_trace.h"
+
+/**
+ * chip8-trace: print a trace written by chip8_trace_init() (or its .dump),
+ * one instruction per line with the registers it left behind.
+ */
+
+#define TRACE_RAW (CHIP8_TRACE_CHUNK * sizeof(chip8_trace_record_t))
+
+static uint8_t raw[TRACE_RAW];
+static uint8_t packed[CHIP8_TRACE_PACK_BOUND(TRACE_RAW)];
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n count] <trace file>\n"
+            "  -n count  stop after count records\n",
+            prog);
+}
+
+static void trace_print(const chip8_trace_record_t *record)
+{
+    char text[CHIP8_DISASM_SIZE];
+
+    printf("%10u  %04X  %04X  %-20s V%X=%02X I=%04X\n", record->cycle,
+           record->pc, record->opcode,
+           chip8_disasm(record->opcode, text, sizeof(text)), record->x,
+           record->vx, record->i_register);
+}
+
+int main(int argc, char **argv)
+{
+    chip8_trace_file_t   header;
+    chip8_trace_frame_t  frame;
+    chip8_trace_record_t record;
+    unsigned long        limit = 0;
+    unsigned long        shown = 0;
+    const char          *mode;
+    FILE                *in;
+    long                 size;
+    int                  opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            limit = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    in = fopen(argv[optind], "rb");
+    if (!in) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, CHIP8_TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != CHIP8_TRACE_VERSION ||
+        header.record_size != sizeof(chip8_trace_record_t)) {
+        fprintf(stderr, "%s: %s is not a version %d trace\n", argv[0],
+                argv[optind], CHIP8_TRACE_VERSION);
+        return 1;
+    }
+
+    mode = chip8_mode_name(header.mode);
+    printf("# rom %016llx mode %s\n", (unsigned long long)header.rom_hash,
+           mode ? mode : "?");
+
+    while (fread(&frame, sizeof(frame), 1, in) == 1) {
+        if (frame.count > CHIP8_TRACE_CHUNK || frame.packed > sizeof(packed) ||
+            fread(packed, 1, frame.packed, in) != frame.packed) {
+            fprintf(stderr, "%s: truncated frame\n", argv[0]);
+            return 1;
+        }
+
+        size = chip8_trace_unpack(packed, frame.packed, raw, sizeof(raw));
+        if (size != (long)(frame.count * sizeof(record))) {
+            fprintf(stderr, "%s: corrupt frame\n", argv[0]);
+            return 1;
+        }
+        chip8_trace_undelta(raw, frame.count);
+
+        for (uint32_t i = 0; i < frame.count; i++) {
+            if (limit && shown++ == limit) {
+                return 0;
+            }
+            memcpy(&record, &raw[i * sizeof(record)], sizeof(record));
+            trace_print(&record);
+        }
+    }
+
+    fclose(in);
+    return 0;
+}